@@ -18,13 +18,22 @@
 #include "algorithm.h"
 #include "lower_bound.h"
 #include "timer.h"
+#include "transposition.h"
 #include "upper_bound.h"
 #include <limits.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 
+/*
+ * Bound on the number of relocations that cannot be reached by any search
+ */
+#define INF_BOUND (INT_MAX / 2)
+
 typedef struct {
   int lb;
+  int bound; // proven bound of remaining relocations if the subtree fails
   state_t *state;
 } node_t;
 
@@ -32,85 +41,508 @@ typedef struct {
   int dst;
   int q_dst;
   int child_lb;
-  state_t *child_state;
+  state_t *child_state; // NULL if the child is regenerated on descent
 } branch_t;
 
-static int compare_branch(const void *a, const void *b) {
+const char *order_names[N_ORDERS] = {"high", "low", "left", "right"};
+
+static int compare_high(const void *a, const void *b) {
   branch_t *x = (branch_t *)a;
   branch_t *y = (branch_t *)b;
   return x->child_lb != y->child_lb ? x->child_lb - y->child_lb
                                     : y->q_dst - x->q_dst;
 }
 
+static int compare_low(const void *a, const void *b) {
+  branch_t *x = (branch_t *)a;
+  branch_t *y = (branch_t *)b;
+  return x->child_lb != y->child_lb ? x->child_lb - y->child_lb
+                                    : x->q_dst - y->q_dst;
+}
+
+static int compare_left(const void *a, const void *b) {
+  branch_t *x = (branch_t *)a;
+  branch_t *y = (branch_t *)b;
+  return x->child_lb != y->child_lb ? x->child_lb - y->child_lb
+                                    : x->dst - y->dst;
+}
+
+static int compare_right(const void *a, const void *b) {
+  branch_t *x = (branch_t *)a;
+  branch_t *y = (branch_t *)b;
+  return x->child_lb != y->child_lb ? x->child_lb - y->child_lb
+                                    : y->dst - x->dst;
+}
+
+static int (*const compare_branch[N_ORDERS])(const void *, const void *) = {
+    compare_high, compare_low, compare_left, compare_right};
+
+typedef struct {
+  int p;              // priority of the relocated block
+  int s;              // source stack
+  branch_t *branches; // sorted branches
+  int size;           // number of branches
+  int next;           // index of the next unexplored branch
+  bool stolen;        // true if any branch is stolen by another worker
+} frame_t;
+
+typedef struct {
+  int p;              // priority of the relocated block
+  int s;              // source stack
+  branch_t *branches; // sorted branches
+  int size;           // number of branches
+  int i;              // index of the branch being searched
+  int mark;           // size of the trail before branching
+  int bound;          // least bound of the branches searched so far
+  uint64_t key;       // key of the node in the transposition table
+} cursor_t;
+
+typedef struct {
+  int id;
+  solver_t *solver;
+  pthread_t thread;
+  pthread_mutex_t lock; // guard for frames, base and top
+
+  /*
+   * Temporary variables
+   */
+  state_t *base_state;  // for work stealing, whose body is the live body
+  state_t *probe_state; // for probing
+  int *array_s1;        // for lower bounding
+  int *array_s2;        // for lower bounding
+  int *array_s3;        // for lower bounding
+  int *array_t1;        // for lower bounding
+  int *array_d1;        // for transposition table
+  trace_t *trace;       // for incremental lower bounding
+  trail_t *trail;       // for branch-and-bound
+  move_t *path;         // for branch-and-bound
+  node_t *hist;         // for branch-and-bound
+  state_t *temp_state;  // for branch-and-bound
+  state_t *child_state; // for compact branch-and-bound
+  state_t **heads;      // for compact branch-and-bound, heads[l] for level l
+  branch_t *pool;       // for branch-and-bound
+  frame_t *frames;      // for work stealing
+  cursor_t *stack;      // for iterative branch-and-bound
+  level_profile_t *profile; // for profiling, NULL if disabled
+
+  /*
+   * Open frames, i.e., levels base, ..., top - 1 whose branches can be stolen
+   */
+  int base;
+  int top;
+
+  /*
+   * Path of a resumed checkpoint being followed from level guide_level, where
+   * the search leaves it as soon as any other branch is taken
+   */
+  resume_path_t *guide; // NULL if none
+  int guide_level;      // level of the next node on the path, -1 if left
+
+  /*
+   * Level of the node where the search is interrupted, -1 if none, and the
+   * first level of the frames owned at that time
+   */
+  int halt;
+  int halt_base;
+
+  /*
+   * Counters
+   */
+  long n_nodes;
+  long n_probe;
+  long n_steal;
+  long n_timer;
+  long n_table_lookup;
+  long n_table_hit;
+  long n_table_cut;
+  long n_table_store;
+  long n_table_reject;
+  long n_rule_cut[N_RULES];
+  stats_t stats;
+} worker_t;
+
+struct solver {
+  /*
+   * Parameters
+   */
+  int n_stacks;
+  int n_tiers;
+  int n_threads;
+  bool verbose;
+  FILE *events;
+  bool wall_clock;
+  bool profiling;
+  bool iterative;
+  unsigned rules;      // enabled dominance rules, bit r for rule r
+  unsigned checked;    // rules that can prune the current instance
+  order_t order;       // order of the branches of a node
+  int probe_slack;     // largest slack of the probed children, 0 if none
+  size_t memory_bytes; // memory budget, 0 if unlimited
+  int capacity;        // maximum depth supported by the path space
+  int depth;           // maximum depth supported by the level space
+  bool compact;        // true if branches regenerate their children
+  size_t peak_bytes;   // peak memory of the current run
+  run_status_t status; // outcome of the last run
+
+  /*
+   * Kernels
+   */
+  lb4_t lb4;
+  copy_t copy_head;
+
+  /*
+   * Temporary variables
+   */
+  instance_t *inst;    // for relabelling
+  int *label;          // for relabelling
+  state_t *root_state; // for initialization
+  worker_t *workers;   // for branch-and-bound
+  table_t *table;      // for branch-and-bound, NULL if disabled
+
+  /*
+   * Report
+   */
+  int root_lb;
+  int best_lb;
+  int best_ub;
+  move_t *best_sol;
+  double start_time;
+  double end_time;
+  double time_to_best_lb;
+  double time_to_best_ub;
+  int n_iterations;
+  level_profile_t *profile; // profile[i * (capacity + 1) + l]
+  int *bounds;              // bounds[i]: depth bound of iteration i
+
+  /*
+   * Synchronization
+   */
+  pthread_mutex_t incumbent_lock;
+  bool concurrent; // true if other threads can stop the search
+  bool stopped;
+  bool interrupted; // true if interrupted by interrupt_solver
+  int n_active;
+
+  /*
+   * Checkpoint
+   */
+  checkpoint_t *resume;     // checkpoint being resumed, NULL if none
+  int next_path;            // index of the next path of the resumed checkpoint
+  checkpoint_t *checkpoint; // checkpoint of the last run, NULL if none
+
+  /*
+   * Portfolio
+   */
+  portfolio_t *portfolio; // portfolio sharing the bounds, NULL if none
+  int member;             // index of the solver in its portfolio
+
+  /*
+   * Timer
+   */
+  long timer_cycle;
+};
+
+struct portfolio {
+  int n_solvers;
+  solver_t **solvers;
+  FILE *events;
+
+  /*
+   * Bounds shared by all solvers, with the configurations that found them
+   */
+  pthread_mutex_t lock;
+  int best_lb;
+  int best_ub;
+  move_t *best_sol; // with relabelled priorities, which all solvers share
+  double time_to_best_lb;
+  double time_to_best_ub;
+  int lb_solver;
+  int ub_solver;
+  int winner; // first solver to close the gap, -1 if none
+
+  /*
+   * Arguments and reports of the current run
+   */
+  instance_t *inst;
+  int time_limit;
+  warm_start_t *warm;
+  double start_time; // common clock of all solvers
+  report_t **reports;
+};
+
+static double now(solver_t *solver) {
+  return solver->wall_clock || solver->n_threads > 1 ? get_wall_time()
+                                                     : get_time();
+}
+
+static void lock(solver_t *solver, pthread_mutex_t *mutex) {
+  if (solver->n_threads > 1) {
+    pthread_mutex_lock(mutex);
+  }
+}
+
+static void unlock(solver_t *solver, pthread_mutex_t *mutex) {
+  if (solver->n_threads > 1) {
+    pthread_mutex_unlock(mutex);
+  }
+}
+
+/*
+ * Progress information, printed as text to stdout if verbose and as JSON lines
+ * to the event stream if any. The end event of the stream is the full report.
+ */
+static void debug_info(solver_t *solver, char *status, long nodes,
+                       long probe) {
+  if (!solver->verbose && solver->events == NULL) {
+    return;
+  }
+  double time_to_best_lb = solver->time_to_best_lb - solver->start_time;
+  double time_to_best_ub = solver->time_to_best_ub - solver->start_time;
+  double time = now(solver) - solver->start_time;
+  int best_ub = __atomic_load_n(&solver->best_ub, __ATOMIC_RELAXED);
+  char config[32] = "";
+  if (solver->verbose) {
+    if (solver->portfolio != NULL) {
+      snprintf(config, sizeof(config), "config = %d / ", solver->member);
+    }
+    fprintf(stdout,
+            "[%s] %sbest_lb = %d @ %.3f / best_ub = %d @ %.3f / time = %.3f / "
+            "nodes = %ld / probe = %ld\n",
+            status, config, solver->best_lb, time_to_best_lb, best_ub,
+            time_to_best_ub, time, nodes, probe);
+    fflush(stdout);
+  }
+  if (solver->events != NULL && strcmp(status, "end") != 0) {
+    if (solver->portfolio != NULL) {
+      snprintf(config, sizeof(config), "\"config\": %d, ", solver->member);
+    }
+    fprintf(solver->events,
+            "{\"event\": \"%s\", %s\"best_lb\": %d, "
+            "\"time_to_best_lb\": %.3f, \"best_ub\": %d, "
+            "\"time_to_best_ub\": %.3f, \"time\": %.3f, \"nodes\": %ld, "
+            "\"probe\": %ld}\n",
+            status, config, solver->best_lb, time_to_best_lb, best_ub,
+            time_to_best_ub, time, nodes, probe);
+    fflush(solver->events);
+  }
+}
+
+static void stop(solver_t *solver) {
+  __atomic_store_n(&solver->stopped, true, __ATOMIC_RELAXED);
+}
+
+static bool is_stopped(solver_t *solver) {
+  return __atomic_load_n(&solver->stopped, __ATOMIC_RELAXED);
+}
+
 /*
- * Temporary variables
+ * Incumbent shared with the other solvers of a portfolio, where a solver
+ * publishes its own improvements and adopts those of the others. The caller
+ * holds the incumbent lock of the solver.
  */
-static state_t *root_state;  // for initialization
-static state_t *probe_state; // for probing
-static int *array_s1;        // for lower bounding
-static int *array_s2;        // for lower bounding
-static int *array_s3;        // for lower bounding
-static int *array_t1;        // for lower bounding
-static move_t *path;         // for branch-and-bound
-static node_t *hist;         // for branch-and-bound
-static state_t *temp_state;  // for branch-and-bound
-static branch_t *pool;       // for branch-and-bound
+static void publish_ub(solver_t *solver) {
+  portfolio_t *p = solver->portfolio;
+  pthread_mutex_lock(&p->lock);
+  if (solver->best_ub < p->best_ub) {
+    __atomic_store_n(&p->best_ub, solver->best_ub, __ATOMIC_RELAXED);
+    p->best_sol = realloc(p->best_sol, sizeof(move_t) * solver->best_ub);
+    memcpy(p->best_sol, solver->best_sol, sizeof(move_t) * solver->best_ub);
+    p->time_to_best_ub = solver->time_to_best_ub;
+    p->ub_solver = solver->member;
+  }
+  pthread_mutex_unlock(&p->lock);
+}
+
+static void adopt_ub(solver_t *solver) {
+  portfolio_t *p = solver->portfolio;
+  if (p == NULL ||
+      __atomic_load_n(&p->best_ub, __ATOMIC_RELAXED) >= solver->best_ub) {
+    return;
+  }
+  pthread_mutex_lock(&p->lock);
+  if (p->best_ub < solver->best_ub) {
+    __atomic_store_n(&solver->best_ub, p->best_ub, __ATOMIC_RELAXED);
+    memcpy(solver->best_sol, p->best_sol, sizeof(move_t) * p->best_ub);
+    solver->time_to_best_ub = p->time_to_best_ub;
+  }
+  pthread_mutex_unlock(&p->lock);
+}
 
 /*
- * Parameters
+ * Incumbent shared by all workers
  */
-static int n_stacks;
-static int n_tiers;
+static bool update_incumbent(worker_t *w, int len, char *status) {
+  solver_t *solver = w->solver;
+  lock(solver, &solver->incumbent_lock);
+  bool improved = len < solver->best_ub;
+  if (improved) {
+    __atomic_store_n(&solver->best_ub, len, __ATOMIC_RELAXED);
+    memcpy(solver->best_sol, w->path, sizeof(move_t) * len);
+    solver->time_to_best_ub = now(solver);
+    debug_info(solver, status, w->n_nodes, w->n_probe);
+    if (solver->portfolio != NULL) {
+      publish_ub(solver);
+    }
+  }
+  unlock(solver, &solver->incumbent_lock);
+  return improved;
+}
 
 /*
- * Report
+ * Frames of branches that may be stolen by idle workers
  */
-static int best_lb;
-static int best_ub;
-static move_t *best_sol;
-static double start_time;
-static double end_time;
-static double time_to_best_lb;
-static double time_to_best_ub;
-static long n_nodes;
-static long n_probe;
+static int open_frame(worker_t *w, int level, int p, int s,
+                      branch_t *branches, int size) {
+  /*
+   * On the path of a resumed checkpoint, the branch on the path comes first,
+   * followed by the siblings left unexplored, and the skipped siblings are
+   * treated as stolen ones
+   */
+  int first = -1;
+  int next = 0;
+  resume_path_t *guide = w->guide;
+  if (guide != NULL && level == w->guide_level && level < guide->depth) {
+    for (int i = 0; i < size; i++) {
+      if (branches[i].dst == guide->dst[level]) {
+        first = i;
+        next = guide->next[level] < 0 || guide->next[level] > size
+                   ? size
+                   : guide->next[level];
+        break;
+      }
+    }
+  }
+  w->guide_level = first >= 0 ? level + 1 : -1;
+
+  lock(w->solver, &w->lock);
+  w->frames[level].p = p;
+  w->frames[level].s = s;
+  w->frames[level].branches = branches;
+  w->frames[level].size = size;
+  w->frames[level].next = first >= 0 ? next : 1;
+  w->frames[level].stolen = first >= 0;
+  w->top = level + 1;
+  unlock(w->solver, &w->lock);
+  return first >= 0 ? first : 0;
+}
+
+static int next_branch(worker_t *w, int level) {
+  w->guide_level = -1;
+  lock(w->solver, &w->lock);
+  int i = w->frames[level].next++;
+  unlock(w->solver, &w->lock);
+  return i;
+}
+
+static bool close_frame(worker_t *w, int level) {
+  lock(w->solver, &w->lock);
+  w->top = level;
+  bool stolen = w->frames[level].stolen;
+  unlock(w->solver, &w->lock);
+  return stolen;
+}
 
 /*
- * Timer
+ * Key of a node in the transposition table. Dominance rules compare times of
+ * last changes and of slots with each other, so two nodes have the same
+ * subtree only if they have the same blocks and the same order of these
+ * times. Times are therefore replaced by their ranks before hashing.
  */
-static long n_timer;
-static long timer_cycle;
+static uint64_t node_key(state_t *state, int level, int *rank) {
+  int n_stacks = state->n_stacks;
+  memset(rank, 0, sizeof(int) * (level + 1));
+  for (int s = 0; s < n_stacks; s++) {
+    rank[state->last_change_time[s]] = 1;
+    for (int t = 1; t <= state->h[s]; t++) {
+      rank[state->l[s][t]] = 1;
+    }
+  }
+  for (int i = 0, r = 0; i <= level; i++) {
+    rank[i] = rank[i] ? r++ : -1;
+  }
 
-static void debug_info(char *status) {
-  fprintf(stdout,
-          "[%s] best_lb = %d @ %.3f / best_ub = %d @ %.3f / time = %.3f / "
-          "nodes = %ld / probe = %ld\n",
-          status, best_lb, time_to_best_lb - start_time, best_ub,
-          time_to_best_ub - start_time, get_time() - start_time, n_nodes,
-          n_probe);
-  fflush(stdout);
+  uint64_t key = state->hash;
+  for (int s = 0; s < n_stacks; s++) {
+    key = mix_hash(key ^ (uint64_t)state->h[s] << 32 ^
+                   (uint32_t)rank[state->last_change_time[s]]);
+    for (int t = 1; t <= state->h[s]; t++) {
+      key = mix_hash(key ^ (uint32_t)rank[state->l[s][t]]);
+    }
+  }
+  return key;
+}
+
+/*
+ * Interruption of a worker at a node, whose path and open frames describe the
+ * work left when the search stops
+ */
+static void halt(worker_t *w, int level) {
+  w->halt = level;
+  w->halt_base = w->base;
 }
 
 /*
- * Branch-and-bound
+ * Branch-and-bound, split into the expansion of a node, the descent into and
+ * the return from its current branch, and its completion, so that the
+ * recursive and the iterative search visit the nodes in the same order
  */
-static bool search(int level, branch_t *branches) {
-  n_nodes++;
+typedef enum {
+  NODE_STOPPED,  // the search stops
+  NODE_FINISHED, // the node fails without branching, with its bound in hist
+  NODE_EXPANDED  // the branches of the node are in its cursor
+} expansion_t;
+
+static expansion_t expand(worker_t *w, int level, branch_t *branches,
+                          cursor_t *c) {
+  solver_t *solver = w->solver;
+  w->n_nodes++;
+  if (w->profile != NULL) {
+    w->profile[level].n_nodes++;
+  }
 
   /*
    * Check time limit
    */
-  if (++n_timer == timer_cycle) {
-    n_timer = 0;
-    if (get_time() >= end_time) {
-      return true;
+  if (++w->n_timer == solver->timer_cycle) {
+    w->n_timer = 0;
+    if (now(solver) >= solver->end_time ||
+        __atomic_load_n(&solver->interrupted, __ATOMIC_RELAXED)) {
+      stop(solver);
+      halt(w, level);
+      return NODE_STOPPED;
+    }
+    lock(solver, &solver->incumbent_lock);
+    debug_info(solver, "running", w->n_nodes, w->n_probe);
+    adopt_ub(solver);
+    bool closed = solver->best_ub <= solver->best_lb;
+    unlock(solver, &solver->incumbent_lock);
+    if (closed) {
+      /*
+       * Another solver of the portfolio found a solution within the bound
+       */
+      stop(solver);
+      halt(w, level);
+      return NODE_STOPPED;
     }
-    debug_info("running");
   }
+  if (solver->concurrent && is_stopped(solver)) {
+    halt(w, level);
+    return NODE_STOPPED;
+  }
+
+  /*
+   * Parameters
+   */
+  int n_stacks = solver->n_stacks;
+  int n_tiers = solver->n_tiers;
+  int best_lb = solver->best_lb;
+  unsigned rules = solver->checked;
 
   /*
    * Current state
    */
+  move_t *path = w->path;
+  node_t *hist = w->hist;
   int curr_lb = hist[level].lb;
   state_t *curr_state = hist[level].state;
 
@@ -131,22 +563,50 @@ static bool search(int level, branch_t *branches) {
       break;
     }
   }
-  if (level + curr_lb + (pn > q_max) -
-          (curr_lb > curr_state->n_bad && pn > q_max) >
-      best_lb) {
-    return false;
+  int bound =
+      curr_lb + (pn > q_max) - (curr_lb > curr_state->n_bad && pn > q_max);
+  if (level + bound > best_lb) {
+    STATS_COUNT(&w->stats, COUNT_LB_NODE);
+    hist[level].bound = bound;
+    return NODE_FINISHED;
+  }
+
+  /*
+   * Transposition table
+   */
+  uint64_t key = 0;
+  if (solver->table != NULL) {
+    key = node_key(curr_state, level, w->array_d1);
+    w->n_table_lookup++;
+    if (lookup_table(solver->table, key, &bound)) {
+      w->n_table_hit++;
+      if (level + bound > best_lb) {
+        w->n_table_cut++;
+        hist[level].bound = bound;
+        return NODE_FINISHED;
+      }
+    }
   }
 
   /*
-   * Prepare branching
+   * Prepare branching, where the children write the live body only above the
+   * current heights, and every write is undone before returning
    */
   int size = 0;
+  int n_feasible = 0;
+  int mark = w->trail->size;
+  bound = INF_BOUND;
 
   /*
    * Enumerate destination stack
    */
   bool first_dn = true;
   bool first_empty = true;
+
+  /*
+   * LB4 of the current state is traced when its first child needs it
+   */
+  bool traced = false;
   for (int dn = 0; dn < n_stacks; dn++) {
     /*
      * Check feasibility
@@ -154,6 +614,7 @@ static bool search(int level, branch_t *branches) {
     if (dn == sn || curr_state->h[dn] == n_tiers) {
       continue;
     }
+    n_feasible++;
 
     /*
      * Update path when generating branches
@@ -167,11 +628,9 @@ static bool search(int level, branch_t *branches) {
      */
     int q_dn = curr_state->q[dn][curr_state->h[dn]];
     if (curr_state->n_bad - 1 + (pn > q_dn) == 0) {
-      best_ub = level + 1;
-      memcpy(best_sol, path, sizeof(move_t) * best_ub);
-      time_to_best_ub = get_time();
-      debug_info("goal");
-      return true;
+      update_incumbent(w, level + 1, "goal");
+      stop(solver);
+      return NODE_STOPPED;
     }
 
     /*
@@ -180,99 +639,183 @@ static bool search(int level, branch_t *branches) {
     if (curr_state->h[dn] == 0) {
       if (first_empty) {
         first_empty = false;
-      } else {
+      } else if (rules & 1u << RULE_EMPTY) {
+        w->n_rule_cut[RULE_EMPTY]++;
         continue; // EA: choose the leftmost empty stack
       }
     }
 
+    /*
+     * Check symmetry rule, i.e., a stack to the left holds the same blocks,
+     * so that both children are equal up to a permutation of stacks
+     */
+    if (rules & 1u << RULE_SYMMETRY && curr_state->h[dn] > 0) {
+      int d = 0;
+      while (d < dn && (d == sn || curr_state->h[d] != curr_state->h[dn] ||
+                        !is_same_stack(curr_state, d, dn))) {
+        d++;
+      }
+      if (d < dn) {
+        w->n_rule_cut[RULE_SYMMETRY]++;
+        continue;
+      }
+    }
+
     /*
      * Check transitive relocation rule
      */
-    if (curr_state->last_change_time[dn] <
-        curr_state->l[sn][curr_state->h[sn]]) {
+    if (rules & 1u << RULE_TRANSITIVE &&
+        curr_state->last_change_time[dn] <
+            curr_state->l[sn][curr_state->h[sn]]) {
+      w->n_rule_cut[RULE_TRANSITIVE]++;
       continue;
     }
 
     /*
      * Lower bounding
      */
-    if (level + curr_lb + (pn > q_dn) -
-            (curr_lb > curr_state->n_bad && pn > q_dn) >
-        best_lb) {
+    int dn_bound =
+        curr_lb + (pn > q_dn) - (curr_lb > curr_state->n_bad && pn > q_dn);
+    if (level + dn_bound > best_lb) {
+      STATS_COUNT(&w->stats, COUNT_LB_DEST);
+      bound = dn_bound < bound ? dn_bound : bound;
       continue;
     }
 
+    /*
+     * Child lower bound, derived from the trace of the current state if the
+     * relocated block is badly placed. The retrievals of the child count
+     * nothing in LB4 and keep its n_bad, which is that of the current state,
+     * so the bound is known before the child is generated.
+     */
+    int child_lb = -1;
+    if (pn > q_dn && curr_state->h[dn] < n_tiers - 1) {
+      STATS_START(lb4_start);
+      if (!traced) {
+        traced = true;
+        STATS_COUNT(&w->stats, COUNT_LB4_TRACE);
+        lb4_trace(curr_state, curr_lb - curr_state->n_bad, w->trace);
+      }
+      child_lb = lb4_child(w->trace, curr_state->n_bad, pn, dn, w->array_t1);
+      STATS_STOP(&w->stats, TIMER_LB4, lb4_start);
+      if (child_lb >= 0) {
+        STATS_COUNT(&w->stats, COUNT_LB4_CHILD);
+      }
+      if (child_lb >= 0 && level + 1 + child_lb > best_lb) {
+        STATS_COUNT(&w->stats, COUNT_LB_TRACED);
+        bound = 1 + child_lb < bound ? 1 + child_lb : bound;
+        continue;
+      }
+    }
+
+    STATS_START(copy_start);
     if (first_dn) {
       first_dn = false;
-      copy_state_body(hist[level + 1].state, curr_state);
-      copy_state_head(temp_state, curr_state);
-      reuse_state_body(temp_state, hist[level + 1].state);
-      move_out(temp_state, sn, level + 1);
-    }
-    state_t *child_state = branches[size].child_state;
-    copy_state_head(child_state, temp_state);
-    reuse_state_body(child_state, hist[level + 1].state);
+      solver->copy_head(w->temp_state, curr_state);
+      reuse_state_body(w->temp_state, curr_state);
+      move_out(w->temp_state, sn, level + 1);
+    }
+    state_t *child_state =
+        solver->compact ? w->child_state : branches[size].child_state;
+    solver->copy_head(child_state, w->temp_state);
+    reuse_state_body(child_state, curr_state);
     move_in(child_state, dn, pn, level + 1);
+    STATS_STOP(&w->stats, TIMER_COPY, copy_start);
 
     /*
      * Retrieve
      */
-    bool dominated = false;
+    STATS_START(retrieve_start);
+    int dominated = -1;
     while (is_retrievable(child_state)) {
       int s_min = child_state->list[0];
-      int l = child_state->l[s_min][child_state->h[s_min]];
+      int h_min = child_state->h[s_min];
+      int l = child_state->l[s_min][h_min];
 
       if (l > 0) {
-        for (int d = 0; d < s_min; d++) {
-          /*
-           * Check retrieval rule
-           */
+        /*
+         * Check retrieval rule, i.e., the block could have been put on a
+         * stack to the left that is unchanged since and not higher
+         */
+        for (int d = 0; rules & 1u << RULE_RETRIEVAL && d < s_min; d++) {
+          if (child_state->last_change_time[d] < l &&
+              child_state->h[d] <= h_min - 1) {
+            dominated = RULE_RETRIEVAL;
+            break;
+          }
+        }
+
+        /*
+         * Check exchange rule, i.e., the block could have been put on a
+         * stack to the right that is unchanged since and lower. Both rules
+         * keep of any such twins the path whose stack comes first by height
+         * and then by index, so they remain consistent with each other.
+         */
+        for (int d = s_min + 1;
+             rules & 1u << RULE_EXCHANGE && dominated < 0 && d < n_stacks;
+             d++) {
           if (child_state->last_change_time[d] < l &&
-              child_state->h[d] <= child_state->h[s_min] - 1) {
-            dominated = true;
+              child_state->h[d] < h_min - 1) {
+            dominated = RULE_EXCHANGE;
             break;
           }
         }
-        if (dominated) {
+        if (dominated >= 0) {
           break;
         }
       }
 
+      STATS_COUNT(&w->stats, COUNT_RETRIEVE);
       retrieve(child_state, level + 1);
     }
+    STATS_STOP(&w->stats, TIMER_RETRIEVE, retrieve_start);
 
-    if (dominated) {
+    if (dominated >= 0) {
+      w->n_rule_cut[dominated]++;
       continue;
     }
 
     /*
-     * Child lower bound
+     * Child lower bound computed from scratch unless derived from the trace
      */
-    int child_lb = lb4(child_state, best_lb - level - child_state->n_bad,
-                       array_s1, array_s2, array_s3, array_t1);
+    if (child_lb < 0) {
+      STATS_START(lb4_start);
+      STATS_COUNT(&w->stats, COUNT_LB4);
+      child_lb = solver->lb4(child_state, best_lb - level - child_state->n_bad,
+                             w->array_s1, w->array_s2, w->array_s3,
+                             w->array_t1);
+      STATS_STOP(&w->stats, TIMER_LB4, lb4_start);
+    }
 
     /*
      * Lower bounding
      */
     if (level + 1 + child_lb > best_lb) {
+      STATS_COUNT(&w->stats, COUNT_LB_CHILD);
+      bound = 1 + child_lb < bound ? 1 + child_lb : bound;
       continue;
     }
 
     /*
      * Probing
      */
-    if (level + 1 + child_lb == best_lb - 1) {
-      n_probe++;
-      copy_state(probe_state, child_state);
-      int new_len = minmax(probe_state, path, level + 1, best_ub - 1);
-      if (new_len != INT_MAX) {
-        best_ub = new_len;
-        memcpy(best_sol, path, sizeof(move_t) * best_ub);
-        time_to_best_ub = get_time();
-        debug_info("update");
-        if (best_lb == best_ub) {
-          return true;
-        }
+    int slack = best_lb - level - 1 - child_lb;
+    if (slack >= 1 && slack <= solver->probe_slack) {
+      w->n_probe++;
+      STATS_COUNT(&w->stats, COUNT_MINMAX);
+      STATS_START(minmax_start);
+      copy_state_head(w->probe_state, child_state);
+      reuse_state_body(w->probe_state, child_state);
+      int probe_mark = w->trail->size;
+      int new_len =
+          minmax(w->probe_state, path, level + 1,
+                 __atomic_load_n(&solver->best_ub, __ATOMIC_RELAXED) - 1);
+      undo_trail(w->probe_state, probe_mark);
+      STATS_STOP(&w->stats, TIMER_MINMAX, minmax_start);
+      if (new_len != INT_MAX && update_incumbent(w, new_len, "update") &&
+          best_lb == new_len) {
+        stop(solver);
+        return NODE_STOPPED;
       }
     }
 
@@ -285,159 +828,1296 @@ static bool search(int level, branch_t *branches) {
     size++;
   }
 
+  STATS_START(undo_start);
+  undo_trail(curr_state, mark);
+  STATS_STOP(&w->stats, TIMER_UNDO, undo_start);
+
+  if (w->profile != NULL) {
+    level_profile_t *profile = &w->profile[level];
+    profile->n_branches += size;
+    profile->n_pruned += n_feasible - size;
+    for (int i = 0; i < size; i++) {
+      int slack = best_lb - level - 1 - branches[i].child_lb;
+      profile->slack[slack < N_SLACK ? slack : N_SLACK - 1]++;
+    }
+  }
+
   /*
-   * Depth-first search
+   * Branches sorted for the depth-first search
    */
   if (size > 0) {
-    qsort(branches, size, sizeof(branch_t), compare_branch);
+    qsort(branches, size, sizeof(branch_t), compare_branch[solver->order]);
+  }
+  c->p = pn;
+  c->s = sn;
+  c->branches = branches;
+  c->size = size;
+  c->i = size > 0 ? open_frame(w, level, pn, sn, branches, size) : 0;
+  c->mark = mark;
+  c->bound = bound;
+  c->key = key;
+  return NODE_EXPANDED;
+}
 
-    for (int i = 0; i < size; i++) {
-      path[level].p = pn;
-      path[level].s = sn;
-      path[level].d = branches[i].dst;
+static void descend(worker_t *w, int level, cursor_t *c) {
+  node_t *hist = w->hist;
+  move_t *path = w->path;
+  state_t *curr_state = hist[level].state;
+  branch_t *branch = &c->branches[c->i];
+
+  path[level].p = c->p;
+  path[level].s = c->s;
+  path[level].d = branch->dst;
+
+  hist[level + 1].lb = branch->child_lb;
+  if (w->solver->compact) {
+    /*
+     * Regenerate the child as in branching, where its retrievals passed the
+     * retrieval rule
+     */
+    STATS_START(copy_start);
+    state_t *child_state = w->heads[level + 1];
+    w->solver->copy_head(child_state, curr_state);
+    reuse_state_body(child_state, curr_state);
+    move_out(child_state, c->s, level + 1);
+    move_in(child_state, branch->dst, c->p, level + 1);
+    while (is_retrievable(child_state)) {
+      retrieve(child_state, level + 1);
+    }
+    STATS_STOP(&w->stats, TIMER_COPY, copy_start);
+    reuse_state_head(hist[level + 1].state, child_state);
+    reuse_state_body(hist[level + 1].state, curr_state);
+    return;
+  }
+  reuse_state_head(hist[level + 1].state, branch->child_state);
+  reuse_state_body(hist[level + 1].state, curr_state);
+
+  int dn = path[level].d;
+  if (hist[level + 1].state->h[dn] == curr_state->h[dn] + 1) {
+    update_slot(hist[level + 1].state, dn, hist[level + 1].state->h[dn],
+                path[level].p, level + 1);
+  }
+}
+
+static void ascend(worker_t *w, int level, cursor_t *c) {
+  node_t *hist = w->hist;
+  STATS_START(backtrack_start);
+  undo_trail(hist[level].state, c->mark);
+  STATS_STOP(&w->stats, TIMER_UNDO, backtrack_start);
+  if (1 + hist[level + 1].bound < c->bound) {
+    c->bound = 1 + hist[level + 1].bound;
+  }
+}
+
+static void finish(worker_t *w, int level, cursor_t *c) {
+  solver_t *solver = w->solver;
+  int best_lb = solver->best_lb;
+  int bound = c->bound;
+  if (c->size > 0 && close_frame(w, level) && best_lb - level + 1 < bound) {
+    /*
+     * Stolen branches fail unless the search stops, so the current bound is
+     * the least bound of the subtree
+     */
+    bound = best_lb - level + 1;
+  }
+
+  /*
+   * Store the proven bound
+   */
+  w->hist[level].bound = bound;
+  if (solver->table != NULL) {
+    w->n_table_store++;
+    if (!store_table(solver->table, c->key, bound)) {
+      w->n_table_reject++;
+    }
+  }
+}
+
+/*
+ * Recursive depth-first search, where the branches of the children are
+ * generated in the pool after those of the node
+ */
+static bool search(worker_t *w, int level, branch_t *branches) {
+  cursor_t c;
+  expansion_t e = expand(w, level, branches, &c);
+  if (e != NODE_EXPANDED) {
+    return e == NODE_STOPPED;
+  }
+  for (; c.i < c.size; c.i = next_branch(w, level)) {
+    descend(w, level, &c);
+    if (search(w, level + 1, branches + c.size)) {
+      return true;
+    }
+    ascend(w, level, &c);
+  }
+  finish(w, level, &c);
+  return false;
+}
+
+/*
+ * Iterative depth-first search with the cursors of the levels on an explicit
+ * stack, visiting the nodes in the same order as the recursive search
+ */
+static bool search_iterative(worker_t *w, int level, branch_t *branches) {
+  int base = level;
+  cursor_t *stack = w->stack;
+  expansion_t e = expand(w, level, branches, &stack[level]);
+  for (;;) {
+    if (e == NODE_STOPPED) {
+      return true;
+    }
+    cursor_t *c = &stack[level];
+    if (e == NODE_EXPANDED && c->i < c->size) {
+      descend(w, level, c);
+      level++;
+      e = expand(w, level, c->branches + c->size, &stack[level]);
+      continue;
+    }
+    if (e == NODE_EXPANDED) {
+      finish(w, level, c);
+    }
+    if (level == base) {
+      return false;
+    }
+    level--;
+    c = &stack[level];
+    ascend(w, level, c);
+    c->i = next_branch(w, level);
+    e = NODE_EXPANDED;
+  }
+}
 
-      hist[level + 1].lb = branches[i].child_lb;
-      reuse_state_head(hist[level + 1].state, branches[i].child_state);
+/*
+ * Search from a node by the engine chosen for the solver
+ */
+static bool search_from(worker_t *w, int level) {
+  return w->solver->iterative ? search_iterative(w, level, w->pool)
+                              : search(w, level, w->pool);
+}
+
+/*
+ * Work stealing
+ */
+static void replay(state_t *state, move_t *move, int l) {
+  relocate(state, move->s, move->d, l);
+  while (is_retrievable(state)) {
+    retrieve(state, l);
+  }
+}
 
-      int dn = path[level].d;
-      if (hist[level + 1].state->h[dn] == curr_state->h[dn] + 1) {
-        update_slot(hist[level + 1].state, dn, hist[level + 1].state->h[dn],
-                    path[level].p, level + 1);
+static bool steal(worker_t *w) {
+  solver_t *solver = w->solver;
+  for (int k = 1; k < solver->n_threads; k++) {
+    worker_t *v = &solver->workers[(w->id + k) % solver->n_threads];
+    int level = -1;
+    int child_lb = 0;
+
+    lock(solver, &v->lock);
+    for (int i = v->base; i < v->top; i++) {
+      frame_t *frame = &v->frames[i];
+      if (frame->next < frame->size) {
+        branch_t *branch = &frame->branches[frame->next++];
+        frame->stolen = true;
+        level = i;
+        child_lb = branch->child_lb;
+        memcpy(w->path, v->path, sizeof(move_t) * level);
+        w->path[level].p = frame->p;
+        w->path[level].s = frame->s;
+        w->path[level].d = branch->dst;
+        __atomic_add_fetch(&solver->n_active, 1, __ATOMIC_ACQ_REL);
+        break;
       }
+    }
+    unlock(solver, &v->lock);
 
-      if (search(level + 1, branches + size)) {
-        return true;
+    if (level >= 0) {
+      /*
+       * Rebuild the stolen child from the root
+       */
+      copy_state(w->base_state, solver->root_state);
+      for (int i = 0; i <= level; i++) {
+        replay(w->base_state, &w->path[i], i + 1);
       }
+      reuse_state_head(w->hist[level + 1].state, w->base_state);
+      reuse_state_body(w->hist[level + 1].state, w->base_state);
+      w->trail->size = 0;
+      w->hist[level + 1].lb = child_lb;
+
+      lock(solver, &w->lock);
+      w->base = w->top = level + 1;
+      unlock(solver, &w->lock);
+
+      w->n_steal++;
+      return true;
     }
   }
+  return false;
+}
 
+static void deactivate(worker_t *w) {
+  lock(w->solver, &w->lock);
+  w->base = w->top = 0;
+  unlock(w->solver, &w->lock);
+  __atomic_sub_fetch(&w->solver->n_active, 1, __ATOMIC_ACQ_REL);
+}
+
+/*
+ * Search from the root by the first worker, once along each remaining path of
+ * the resumed checkpoint if any, where the body of a copy of the root becomes
+ * the live body
+ */
+static bool search_root(worker_t *w) {
+  solver_t *solver = w->solver;
+  checkpoint_t *resume = solver->resume;
+  do {
+    if (is_stopped(solver)) {
+      return true;
+    }
+    copy_state(w->base_state, solver->root_state);
+    w->hist[0].state = w->base_state;
+    w->hist[0].lb = solver->root_lb;
+    w->trail->size = 0;
+    w->guide = resume != NULL && solver->next_path < resume->n_paths
+                   ? &resume->paths[solver->next_path++]
+                   : NULL;
+    w->guide_level = 0;
+    if (search_from(w, 0)) {
+      return true;
+    }
+  } while (resume != NULL && solver->next_path < resume->n_paths);
   return false;
 }
 
-report_t *solve(instance_t *inst, int _t) {
+static void *work(void *arg) {
+  worker_t *w = arg;
+  solver_t *solver = w->solver;
+
+  if (w->id == 0) {
+    search_root(w);
+    deactivate(w);
+  }
+
+  while (!is_stopped(solver)) {
+    if (steal(w)) {
+      search_from(w, w->base);
+      deactivate(w);
+    } else if (__atomic_load_n(&solver->n_active, __ATOMIC_ACQUIRE) == 0) {
+      break;
+    } else {
+      sched_yield();
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * One iteration of iterative deepening with all workers
+ */
+static bool run_iteration(solver_t *solver) {
+  worker_t *workers = solver->workers;
+  for (int i = 0; i < solver->n_threads; i++) {
+    workers[i].halt = -1;
+  }
+  if (solver->n_threads == 1) {
+    return search_root(&workers[0]);
+  }
+
+  solver->stopped = __atomic_load_n(&solver->interrupted, __ATOMIC_RELAXED);
+  solver->n_active = 1;
+  for (int i = 0; i < solver->n_threads; i++) {
+    pthread_create(&workers[i].thread, NULL, work, &workers[i]);
+  }
+  for (int i = 0; i < solver->n_threads; i++) {
+    pthread_join(workers[i].thread, NULL);
+  }
+  return solver->stopped;
+}
+
+/*
+ * Space of workers
+ */
+static void init_worker(worker_t *w, solver_t *solver, int id) {
+  int n_stacks = solver->n_stacks;
+  int n_tiers = solver->n_tiers;
+
+  w->id = id;
+  w->solver = solver;
+  pthread_mutex_init(&w->lock, NULL);
+
+  /*
+   * Temporary variables for lower bounding
+   */
+  w->array_s1 = malloc(sizeof(int) * n_stacks);
+  w->array_s2 = malloc(sizeof(int) * n_stacks);
+  w->array_s3 = malloc(sizeof(int) * n_stacks);
+  w->array_t1 = malloc(sizeof(int) * n_tiers);
+  w->array_d1 = NULL;
+  w->trace = malloc_trace(n_stacks, n_tiers);
+  w->trail = malloc_trail(n_stacks * n_tiers);
+
+  /*
+   * Temporary variables for branch-and-bound, whose depth-dependent parts are
+   * allocated by reserve_worker
+   */
+  w->base_state = malloc_state(n_stacks, n_tiers, true, true, true);
+  w->base_state->hashed = solver->table != NULL;
+  w->base_state->trail = w->trail;
+  w->probe_state = malloc_state(n_stacks, n_tiers, true, false, false);
+  w->probe_state->trail = w->trail;
+  w->temp_state = malloc_state(n_stacks, n_tiers, true, false, true);
+  w->temp_state->hashed = solver->table != NULL;
+  w->child_state = malloc_state(n_stacks, n_tiers, true, false, true);
+  w->child_state->hashed = solver->table != NULL;
+  w->child_state->trail = w->trail;
+  w->heads = NULL;
+  w->path = NULL;
+  w->hist = NULL;
+  w->pool = NULL;
+  w->frames = NULL;
+  w->stack = NULL;
+  w->profile = NULL;
+  w->guide = NULL;
+  w->guide_level = -1;
+  w->halt = -1;
+}
+
+/*
+ * Space of paths, which covers the longest solution
+ */
+static void reserve_worker(worker_t *w, int new_depth) {
+  w->array_d1 = realloc(w->array_d1, sizeof(int) * (new_depth + 1));
+  w->path = realloc(w->path, sizeof(move_t) * new_depth);
+  if (w->solver->profiling) {
+    w->profile =
+        realloc(w->profile, sizeof(level_profile_t) * (new_depth + 1));
+  }
+}
+
+static state_t *malloc_head(worker_t *w) {
+  state_t *state =
+      malloc_state(w->solver->n_stacks, w->solver->n_tiers, true, false, true);
+  state->hashed = w->solver->table != NULL;
+  state->trail = w->trail;
+  return state;
+}
+
+/*
+ * Space of levels, which only covers the current depth of the search. Every
+ * branch holds its child head unless the branches are compact, in which case
+ * each level holds a single head regenerated on descent.
+ */
+static void grow_levels(worker_t *w, int old_depth, int new_depth) {
+  int n_stacks = w->solver->n_stacks;
+  int n_tiers = w->solver->n_tiers;
+
+  w->hist = realloc(w->hist, sizeof(node_t) * (new_depth + 1));
+  for (int i = old_depth + 1; i <= new_depth; i++) {
+    w->hist[i].state = malloc_state(n_stacks, n_tiers, false, false, true);
+    w->hist[i].state->trail = w->trail;
+  }
+  w->pool = realloc(w->pool, sizeof(branch_t) * new_depth * (n_stacks - 1));
+  for (int i = old_depth * (n_stacks - 1); i < new_depth * (n_stacks - 1);
+       i++) {
+    w->pool[i].child_state = w->solver->compact ? NULL : malloc_head(w);
+  }
+  if (w->solver->compact) {
+    w->heads = realloc(w->heads, sizeof(state_t *) * (new_depth + 1));
+    for (int i = old_depth + 1; i <= new_depth; i++) {
+      w->heads[i] = malloc_head(w);
+    }
+  }
+  w->frames = realloc(w->frames, sizeof(frame_t) * new_depth);
+  w->stack = realloc(w->stack, sizeof(cursor_t) * (new_depth + 1));
+}
+
+static void free_heads(worker_t *w, int depth) {
+  for (int i = 0; i < depth * (w->solver->n_stacks - 1); i++) {
+    if (w->pool[i].child_state != NULL) {
+      free_state(w->pool[i].child_state);
+      w->pool[i].child_state = NULL;
+    }
+  }
+  if (w->heads != NULL) {
+    for (int i = 1; i <= depth; i++) {
+      free_state(w->heads[i]);
+    }
+    free(w->heads);
+    w->heads = NULL;
+  }
+}
+
+static void compact_levels(worker_t *w, int depth) {
+  free_heads(w, depth);
+  w->heads = malloc(sizeof(state_t *) * (depth + 1));
+  for (int i = 1; i <= depth; i++) {
+    w->heads[i] = malloc_head(w);
+  }
+}
+
+static void free_worker(worker_t *w) {
+  int depth = w->solver->depth;
+
+  pthread_mutex_destroy(&w->lock);
+  free(w->array_s1);
+  free(w->array_s2);
+  free(w->array_s3);
+  free(w->array_t1);
+  free(w->array_d1);
+  free_trace(w->trace);
+  free_trail(w->trail);
+  free_state(w->base_state);
+  free_state(w->probe_state);
+  free_state(w->temp_state);
+  free_state(w->child_state);
+  free(w->path);
+  free_heads(w, depth);
+  for (int i = 1; i <= depth; i++) {
+    free_state(w->hist[i].state);
+  }
+  free(w->hist);
+  free(w->pool);
+  free(w->frames);
+  free(w->stack);
+  free(w->profile);
+}
+
+static void reset_worker(worker_t *w) {
+  w->base = 0;
+  w->top = 0;
+  w->n_nodes = 0;
+  w->n_probe = 0;
+  w->n_steal = 0;
+  w->n_timer = 0;
+  w->n_table_lookup = 0;
+  w->n_table_hit = 0;
+  w->n_table_cut = 0;
+  w->n_table_store = 0;
+  w->n_table_reject = 0;
+  memset(w->n_rule_cut, 0, sizeof(w->n_rule_cut));
+  memset(&w->stats, 0, sizeof(stats_t));
+}
+
+static long total_nodes(solver_t *solver) {
+  long n_nodes = 0;
+  for (int i = 0; i < solver->n_threads; i++) {
+    n_nodes += solver->workers[i].n_nodes;
+  }
+  return n_nodes;
+}
+
+static long total_probe(solver_t *solver) {
+  long n_probe = 0;
+  for (int i = 0; i < solver->n_threads; i++) {
+    n_probe += solver->workers[i].n_probe;
+  }
+  return n_probe;
+}
+
+/*
+ * Profile of each iteration, summed over all workers
+ */
+static void begin_profile(solver_t *solver) {
+  if (!solver->profiling) {
+    return;
+  }
+  for (int i = 0; i < solver->n_threads; i++) {
+    memset(solver->workers[i].profile, 0,
+           sizeof(level_profile_t) * (solver->capacity + 1));
+  }
+}
+
+static void end_profile(solver_t *solver) {
+  if (!solver->profiling) {
+    return;
+  }
+  int n_levels = solver->capacity + 1;
+  solver->profile =
+      realloc(solver->profile, sizeof(level_profile_t) * n_levels *
+                                   (solver->n_iterations + 1));
+  level_profile_t *profile = solver->profile + solver->n_iterations * n_levels;
+  memset(profile, 0, sizeof(level_profile_t) * n_levels);
+  solver->bounds =
+      realloc(solver->bounds, sizeof(int) * (solver->n_iterations + 1));
+  solver->bounds[solver->n_iterations] = solver->best_lb;
+  for (int i = 0; i < solver->n_threads; i++) {
+    level_profile_t *src = solver->workers[i].profile;
+    for (int l = 0; l < n_levels; l++) {
+      profile[l].n_nodes += src[l].n_nodes;
+      profile[l].n_branches += src[l].n_branches;
+      profile[l].n_pruned += src[l].n_pruned;
+      for (int k = 0; k < N_SLACK; k++) {
+        profile[l].slack[k] += src[l].slack[k];
+      }
+    }
+  }
+  solver->n_iterations++;
+}
+
+/*
+ * Solver
+ */
+void default_params(params_t *params) {
+  params->n_threads = 1;
+  params->verbose = true;
+  params->events = NULL;
+  params->wall_clock = false;
+  params->table_bytes = 0;
+  params->table_policy = REPLACE_DEPTH;
+  params->specialized = true;
+  params->profile = false;
+  params->iterative = false;
+  params->memory_bytes = 0;
+  params->rules = ALL_RULES;
+  params->order = ORDER_HIGH;
+  params->probe_slack = 1;
+}
+
+solver_t *malloc_solver(int n_stacks, int n_tiers, params_t *params) {
+  solver_t *solver = malloc(sizeof(solver_t));
+  solver->n_stacks = n_stacks;
+  solver->n_tiers = n_tiers;
+  solver->n_threads = params->n_threads < 1 ? 1 : params->n_threads;
+  solver->verbose = params->verbose;
+  solver->events = params->events;
+  solver->wall_clock = params->wall_clock;
+  solver->profiling = params->profile;
+  solver->iterative = params->iterative;
+  solver->rules = params->rules;
+  solver->checked = params->rules;
+  solver->order = params->order;
+  solver->probe_slack = params->probe_slack;
+  solver->memory_bytes = params->memory_bytes;
+  solver->capacity = 0;
+  solver->depth = 0;
+  solver->compact = false;
+  solver->peak_bytes = 0;
+  if (params->specialized) {
+    solver->lb4 = find_lb4(n_stacks, n_tiers);
+    solver->copy_head = find_copy_head(n_stacks, n_tiers);
+  } else {
+    solver->lb4 = lb4;
+    solver->copy_head = copy_state_head;
+  }
+
+  solver->table = params->table_bytes > 0
+                      ? malloc_table(params->table_bytes, params->table_policy)
+                      : NULL;
+  solver->inst = malloc_instance(n_stacks, n_tiers);
+  solver->label = malloc(sizeof(int) * (n_stacks * n_tiers + 1));
+  solver->root_state = malloc_state(n_stacks, n_tiers, true, true, true);
+  solver->root_state->hashed = solver->table != NULL;
+  solver->workers = malloc(sizeof(worker_t) * solver->n_threads);
+  for (int i = 0; i < solver->n_threads; i++) {
+    init_worker(&solver->workers[i], solver, i);
+  }
+  solver->best_sol = NULL;
+  solver->profile = NULL;
+  solver->bounds = NULL;
+  solver->interrupted = false;
+  solver->resume = NULL;
+  solver->checkpoint = NULL;
+
+  pthread_mutex_init(&solver->incumbent_lock, NULL);
+  solver->concurrent = solver->n_threads > 1;
+  solver->portfolio = NULL;
+  solver->member = 0;
+  solver->timer_cycle = 1000000;
+  return solver;
+}
+
+void free_solver(solver_t *solver) {
+  for (int i = 0; i < solver->n_threads; i++) {
+    free_worker(&solver->workers[i]);
+  }
+  free(solver->workers);
+  free_instance(solver->inst);
+  free(solver->label);
+  free_state(solver->root_state);
+  if (solver->table != NULL) {
+    free_table(solver->table);
+  }
+  free(solver->best_sol);
+  free(solver->profile);
+  free(solver->bounds);
+  if (solver->checkpoint != NULL) {
+    free_checkpoint(solver->checkpoint);
+  }
+  pthread_mutex_destroy(&solver->incumbent_lock);
+  free(solver);
+}
+
+static void reserve_solver(solver_t *solver, int depth) {
+  if (depth <= solver->capacity) {
+    return;
+  }
+  for (int i = 0; i < solver->n_threads; i++) {
+    reserve_worker(&solver->workers[i], depth);
+  }
+  solver->best_sol = realloc(solver->best_sol, sizeof(move_t) * depth);
+  solver->capacity = depth;
+}
+
+/*
+ * Memory of a solver in bytes if its levels cover a depth, counting the
+ * states, the arrays and the transposition table but not the allocator
+ * overhead
+ */
+static size_t solver_bytes(solver_t *solver, int depth, bool compact) {
+  size_t n_stacks = solver->n_stacks;
+  size_t n_tiers = solver->n_tiers;
+  size_t head = sizeof(state_t) + sizeof(int) * 4 * n_stacks;
+  size_t body = sizeof(cell_t *) * 4 * n_stacks +
+                sizeof(cell_t) * 4 * n_stacks * (n_tiers + 1);
+  size_t capacity = solver->capacity;
+
+  size_t level = sizeof(node_t) + sizeof(state_t) + sizeof(frame_t) +
+                 sizeof(cursor_t) + sizeof(branch_t) * (n_stacks - 1) +
+                 (compact ? head + sizeof(state_t *) : head * (n_stacks - 1));
+  size_t worker = 4 * head + body + sizeof(int) * (3 * n_stacks + n_tiers) +
+                  (sizeof(move_t) + sizeof(int)) * (capacity + 1) +
+                  (solver->profiling ? sizeof(level_profile_t) : 0) *
+                      (capacity + 1) +
+                  level * ((size_t)depth + 1);
+  size_t bytes = sizeof(solver_t) + head + body +
+                 sizeof(int) * (n_stacks * (n_tiers + 2) + 1) +
+                 sizeof(move_t) * capacity +
+                 (solver->table != NULL ? table_bytes(solver->table) : 0);
+  for (int i = 0; i < solver->n_threads; i++) {
+    bytes += sizeof(worker_t) + worker +
+             sizeof(slot_t) * solver->workers[i].trail->capacity;
+  }
+  return bytes;
+}
+
+static void update_peak(solver_t *solver) {
+  size_t bytes = solver_bytes(solver, solver->depth, solver->compact);
+  if (bytes > solver->peak_bytes) {
+    solver->peak_bytes = bytes;
+  }
+}
+
+/*
+ * Grow the levels to cover a depth within the memory budget, switching to
+ * compact branches if full ones do not fit. Return false if even compact
+ * branches do not fit.
+ */
+static bool reserve_levels(solver_t *solver, int depth) {
+  if (depth > solver->depth) {
+    size_t budget = solver->memory_bytes;
+    if (budget > 0 && !solver->compact &&
+        solver_bytes(solver, depth, false) > budget) {
+      solver->compact = true;
+      for (int i = 0; i < solver->n_threads; i++) {
+        compact_levels(&solver->workers[i], solver->depth);
+      }
+    }
+    if (budget > 0 && solver_bytes(solver, depth, solver->compact) > budget) {
+      return false;
+    }
+    for (int i = 0; i < solver->n_threads; i++) {
+      grow_levels(&solver->workers[i], solver->depth, depth);
+    }
+    solver->depth = depth;
+  }
+  update_peak(solver);
+  return true;
+}
+
+/*
+ * Bounds shared with the other solvers of a portfolio between iterations,
+ * where a lower bound proven by any configuration holds for all of them.
+ * Return true if the gap is closed, by this solver or by another one.
+ */
+static bool share_bounds(solver_t *solver) {
+  portfolio_t *p = solver->portfolio;
+  if (p == NULL) {
+    return solver->best_lb >= solver->best_ub;
+  }
+  adopt_ub(solver);
+  pthread_mutex_lock(&p->lock);
+  if (solver->best_lb > p->best_lb) {
+    p->best_lb = solver->best_lb;
+    p->time_to_best_lb = solver->time_to_best_lb;
+    p->lb_solver = solver->best_lb > solver->root_lb ? solver->member : -1;
+  } else if (p->best_lb > solver->best_lb) {
+    solver->best_lb =
+        p->best_lb < solver->best_ub ? p->best_lb : solver->best_ub;
+    solver->time_to_best_lb = p->time_to_best_lb;
+  }
+  bool closed = p->winner >= 0;
+  pthread_mutex_unlock(&p->lock);
+  return closed || solver->best_lb >= solver->best_ub;
+}
+
+static int compare_prio(const void *a, const void *b) {
+  int x = *(int *)a;
+  int y = *(int *)b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Relabel priorities to their ranks 1...n_blocks, where equal priorities keep
+ * equal ranks, so that they fit in the cells of the state. Return the largest
+ * rank, where label[r] is the original priority of rank r.
+ */
+static int relabel(solver_t *solver, instance_t *inst) {
+  instance_t *dst = solver->inst;
+  int *label = solver->label;
+
+  int n = 0;
+  for (int s = 0; s < inst->n_stacks; s++) {
+    for (int t = 1; t <= inst->h[s]; t++) {
+      label[++n] = inst->p[s][t];
+    }
+  }
+  qsort(label + 1, n, sizeof(int), compare_prio);
+  int m = 0;
+  for (int i = 1; i <= n; i++) {
+    if (m == 0 || label[i] != label[m]) {
+      label[++m] = label[i];
+    }
+  }
+
+  dst->n_blocks = inst->n_blocks;
+  dst->max_prio = m;
+  for (int s = 0; s < inst->n_stacks; s++) {
+    dst->h[s] = inst->h[s];
+    for (int t = 1; t <= inst->h[s]; t++) {
+      int *r =
+          bsearch(&inst->p[s][t], label + 1, m, sizeof(int), compare_prio);
+      dst->p[s][t] = (int)(r - label);
+    }
+  }
+  return m;
+}
+
+/*
+ * Replay a warm-start solution given with original priorities on a copy of
+ * the root state, and return its length if it is a valid restricted solution
+ * and -1 otherwise
+ */
+static int check_warm(solver_t *solver, state_t *state, warm_start_t *warm) {
+  int m = solver->inst->max_prio;
+  for (int i = 0; i < warm->len; i++) {
+    move_t *move = &warm->sol[i];
+    int *r = bsearch(&move->p, solver->label + 1, m, sizeof(int),
+                     compare_prio);
+    if (state->n_blocks == 0 || r == NULL || move->s < 0 ||
+        move->s >= state->n_stacks || move->d < 0 ||
+        move->d >= state->n_stacks || move->s != state->list[0] ||
+        move->d == move->s || state->h[move->d] == state->n_tiers ||
+        state->p[move->s][state->h[move->s]] != (int)(r - solver->label)) {
+      fprintf(stderr, "Warm-start move %d (%d %d %d) is not valid\n", i + 1,
+              move->p, move->s, move->d);
+      return -1;
+    }
+    solver->best_sol[i] = *move;
+    solver->best_sol[i].p = (int)(r - solver->label);
+    replay(state, move, i + 1);
+  }
+  if (state->n_blocks != 0) {
+    fprintf(stderr, "Warm-start solution leaves %d blocks in the bay\n",
+            state->n_blocks);
+    return -1;
+  }
+  return warm->len;
+}
+
+/*
+ * Checkpoint of an interrupted iteration, i.e., the path of each interrupted
+ * worker with the siblings left in its own frames, followed by the paths of
+ * the resumed checkpoint that are not started yet
+ */
+static checkpoint_t *snapshot(solver_t *solver, instance_t *inst,
+                              int init_ub) {
+  checkpoint_t *ckpt = new_checkpoint(inst, solver->best_ub, solver->best_sol);
+  for (int i = 0; i < solver->best_ub; i++) {
+    ckpt->best_sol[i].p = solver->label[ckpt->best_sol[i].p];
+  }
+  ckpt->init_ub = init_ub;
+  ckpt->best_lb = solver->best_lb;
+  ckpt->time_used = now(solver) - solver->start_time;
+  ckpt->time_to_best_lb = solver->time_to_best_lb - solver->start_time;
+  ckpt->time_to_best_ub = solver->time_to_best_ub - solver->start_time;
+  ckpt->n_nodes = total_nodes(solver);
+  ckpt->n_probe = total_probe(solver);
+  ckpt->rules = solver->rules;
+
+  int *dst = malloc(sizeof(int) * (solver->capacity + 1));
+  int *next = malloc(sizeof(int) * (solver->capacity + 1));
+  for (int i = 0; i < solver->n_threads; i++) {
+    worker_t *w = &solver->workers[i];
+    int depth = w->halt;
+    if (depth < 0) {
+      continue;
+    }
+    if (w->guide != NULL && w->guide_level == depth &&
+        depth < w->guide->depth) {
+      /*
+       * Interrupted on the path being resumed, whose remaining levels are
+       * kept as they are
+       */
+      memcpy(dst, w->guide->dst, sizeof(int) * w->guide->depth);
+      memcpy(next, w->guide->next, sizeof(int) * w->guide->depth);
+      depth = w->guide->depth;
+    } else {
+      for (int l = 0; l < depth; l++) {
+        dst[l] = w->path[l].d;
+      }
+    }
+    for (int l = 0; l < w->halt; l++) {
+      frame_t *frame = &w->frames[l];
+      next[l] = l >= w->halt_base && frame->next < frame->size ? frame->next
+                                                                : -1;
+    }
+    add_resume_path(ckpt, depth, dst, next);
+  }
+  free(dst);
+  free(next);
+
+  checkpoint_t *resume = solver->resume;
+  for (int k = solver->next_path; resume != NULL && k < resume->n_paths; k++) {
+    add_resume_path(ckpt, resume->paths[k].depth, resume->paths[k].dst,
+                    resume->paths[k].next);
+  }
+  return ckpt;
+}
+
+report_t *run_solver(solver_t *solver, instance_t *inst, int _t) {
+  return run_solver_warm(solver, inst, _t, NULL);
+}
+
+report_t *run_solver_warm(solver_t *solver, instance_t *inst, int _t,
+                          warm_start_t *warm) {
+  if (inst->n_stacks != solver->n_stacks || inst->n_tiers != solver->n_tiers) {
+    fprintf(stderr, "Solver for %d x %d cannot solve instance of %d x %d\n",
+            solver->n_stacks, solver->n_tiers, inst->n_stacks, inst->n_tiers);
+    solver->status = RUN_MISMATCH;
+    return NULL;
+  }
+
   /*
    * Parameters
    */
-  n_stacks = inst->n_stacks;
-  n_tiers = inst->n_tiers;
-  start_time = get_time();
-  end_time = start_time + _t;
+  solver->stopped = false;
+  if (solver->portfolio == NULL) {
+    solver->interrupted = false; // reset by the portfolio before its run
+  }
+  solver->peak_bytes = 0;
+  solver->start_time = solver->portfolio != NULL
+                           ? solver->portfolio->start_time
+                           : now(solver);
+  solver->end_time = solver->start_time + _t;
+  worker_t *workers = solver->workers;
+  for (int i = 0; i < solver->n_threads; i++) {
+    reset_worker(&workers[i]);
+  }
+  if (solver->table != NULL) {
+    clear_table(solver->table);
+  }
+  if (solver->checkpoint != NULL) {
+    free_checkpoint(solver->checkpoint);
+    solver->checkpoint = NULL;
+  }
+
+  /*
+   * A resumed checkpoint continues the clock and the counters, and its
+   * incumbent and lower bound are taken as a warm start
+   */
+  checkpoint_t *resume = warm != NULL ? warm->resume : NULL;
+  if (resume != NULL && !match_checkpoint(resume, inst)) {
+    fprintf(stderr, "Checkpoint is not taken from this instance\n");
+    resume = NULL;
+  }
+  if (resume != NULL && resume->rules != solver->rules) {
+    fprintf(stderr, "Checkpoint is taken with other dominance rules, so only"
+                    " its bounds and incumbent are resumed\n");
+  }
+  warm_start_t resumed;
+  if (resume != NULL) {
+    resumed.sol = resume->best_sol;
+    resumed.len = resume->best_ub;
+    resumed.lb = resume->best_lb;
+    resumed.ub = 0;
+    resumed.resume = resume;
+    warm = &resumed;
+    solver->start_time -= resume->time_used;
+    workers[0].n_nodes = resume->n_nodes;
+    workers[0].n_probe = resume->n_probe;
+  }
+  solver->resume = NULL;
+  solver->next_path = 0;
+  solver->status = RUN_REPORTED;
 
   /*
    * Root state
    */
-  root_state = malloc_state(n_stacks, n_tiers, true, true, true);
-  init_state(root_state, inst);
+  if (relabel(solver, inst) >= CELL_MAX) {
+    fprintf(stderr, "Priorities of instance do not fit in %d-bit cells\n",
+            CELL_BITS);
+    solver->status = RUN_UNFIT;
+    return NULL;
+  }
+
+  /*
+   * Non-empty stacks hold the same blocks only if some priorities are equal
+   */
+  solver->checked = solver->rules;
+  if (solver->inst->max_prio == solver->inst->n_blocks) {
+    solver->checked &= ~(1u << RULE_SYMMETRY);
+  }
+  state_t *root_state = solver->root_state;
+  init_state(root_state, solver->inst);
   while (is_retrievable(root_state)) {
     retrieve(root_state, 0);
   }
   if (root_state->n_blocks == 0) {
-    free_state(root_state);
-    return new_report(0, 0, 0, 0, NULL, 0, 0, 0, 0, 0);
+    report_t *report = new_report(0, 0, 0, 0, NULL, 0, 0, 0, 0, 0);
+    if (solver->events != NULL && solver->portfolio == NULL) {
+      print_report_json(solver->events, report);
+    }
+    return report;
   }
 
   /*
    * Check if there is a solution
    */
-  probe_state = malloc_state(n_stacks, n_tiers, true, true, false);
+  state_t *probe_state = workers[0].base_state;
   copy_state(probe_state, root_state);
   int max_depth = minmax(probe_state, NULL, 0, INT_MAX);
   if (max_depth == INT_MAX) {
-    free_state(root_state);
-    free_state(probe_state);
+    if (solver->events != NULL) {
+      fprintf(solver->events, "{\"event\": \"infeasible\"}\n");
+      fflush(solver->events);
+    }
+    solver->status = RUN_INFEASIBLE;
     return NULL;
   }
+  if (max_depth > CELL_MAX) {
+    fprintf(stderr, "Search depth %d does not fit in %d-bit cells\n",
+            max_depth, CELL_BITS);
+    solver->status = RUN_UNFIT;
+    return NULL;
+  }
+  reserve_solver(solver, max_depth);
 
   /*
-   * Temporary variables for lower bounding
-   */
-  array_s1 = malloc(sizeof(int) * n_stacks);
-  array_s2 = malloc(sizeof(int) * n_stacks);
-  array_s3 = malloc(sizeof(int) * n_stacks);
-  array_t1 = malloc(sizeof(int) * n_tiers);
-
-  /*
-   * Temporary variables for branch-and-bound
+   * Warm-start solution, used only if it is no longer than the heuristic one
    */
-  path = malloc(sizeof(move_t) * max_depth);
-  hist = malloc(sizeof(node_t) * (max_depth + 1));
-  for (int i = 1; i <= max_depth; i++) {
-    hist[i].state = malloc_state(n_stacks, n_tiers, false, true, true);
-  }
-  temp_state = malloc_state(n_stacks, n_tiers, true, false, true);
-  pool = malloc(sizeof(branch_t) * max_depth * (n_stacks - 1));
-  for (int i = 0; i < max_depth * (n_stacks - 1); i++) {
-    pool[i].child_state = malloc_state(n_stacks, n_tiers, true, false, true);
+  int warm_len = -1;
+  if (warm != NULL && warm->sol != NULL && warm->len <= max_depth) {
+    copy_state(probe_state, root_state);
+    warm_len = check_warm(solver, probe_state, warm);
+    if (warm_len != -1) {
+      max_depth = warm_len;
+    }
   }
 
   /*
    * Root lower bound
    */
-  int root_lb =
-      lb4(root_state, INT_MAX, array_s1, array_s2, array_s3, array_t1);
+  int root_lb = solver->lb4(root_state, INT_MAX, workers[0].array_s1,
+                            workers[0].array_s2, workers[0].array_s3,
+                            workers[0].array_t1);
 
   /*
    * Initialize best lower and upper bounds
    */
-  best_lb = root_lb;
-  time_to_best_lb = start_time;
-  best_sol = malloc(sizeof(move_t) * max_depth);
-  copy_state(probe_state, root_state);
-  best_ub = minmax(probe_state, best_sol, 0, INT_MAX);
-  time_to_best_ub = start_time;
+  solver->best_lb = root_lb;
+  solver->time_to_best_lb = solver->start_time;
+  if (warm_len == max_depth) {
+    solver->best_ub = warm_len;
+  } else {
+    copy_state(probe_state, root_state);
+    solver->best_ub = minmax(probe_state, solver->best_sol, 0, INT_MAX);
+  }
+  solver->time_to_best_ub = solver->start_time;
+  int init_ub = solver->best_ub;
+  if (resume != NULL && warm_len == resume->best_ub) {
+    init_ub = resume->init_ub;
+    solver->time_to_best_lb = solver->start_time + resume->time_to_best_lb;
+    solver->time_to_best_ub = solver->start_time + resume->time_to_best_ub;
+  }
 
   /*
-   * Initialize history
+   * Bounds claimed by the caller are trusted: a lower bound skips the
+   * iterations below it, and an upper bound without a plan tightens the
+   * probes until a plan of that length is found or the claim is refuted
    */
-  hist[0].state = root_state;
-  hist[0].lb = root_lb;
+  if (warm != NULL && warm->lb > solver->best_lb) {
+    solver->best_lb =
+        warm->lb < solver->best_ub ? warm->lb : solver->best_ub;
+  }
+  int plan_ub = solver->best_ub;
+  int claim_ub = INT_MAX;
+  if (warm != NULL && warm->ub >= solver->best_lb &&
+      warm->ub < solver->best_ub) {
+    claim_ub = warm->ub + 1;
+    solver->best_ub = claim_ub;
+  }
+  if (resume != NULL && resume->rules == solver->rules &&
+      warm_len == resume->best_ub && solver->best_lb == resume->best_lb) {
+    solver->resume = resume;
+  }
+
+  solver->root_lb = root_lb;
 
   /*
    * Iterative deepening search
    */
-  n_nodes = 0;
-  n_probe = 0;
-  n_timer = 0;
-  timer_cycle = 1000000;
-
-  debug_info("start");
-  while (best_lb < best_ub) {
-    if (search(0, pool)) {
+  debug_info(solver, "start", 0, 0);
+  solver->n_iterations = 0;
+  while (!share_bounds(solver)) {
+    if (!reserve_levels(solver, solver->best_lb)) {
+      fprintf(stderr, "Memory budget of %zu bytes is exceeded at depth %d\n",
+              solver->memory_bytes, solver->best_lb);
+      debug_info(solver, "memory", total_nodes(solver), total_probe(solver));
+      break;
+    }
+    begin_profile(solver);
+    bool stopped = run_iteration(solver);
+    end_profile(solver);
+    if (stopped) {
       break;
     }
-    best_lb++;
-    time_to_best_lb = get_time();
-    debug_info("deepen");
+    solver->resume = NULL;
+    solver->best_lb++;
+    solver->time_to_best_lb = now(solver);
+    debug_info(solver, "deepen", total_nodes(solver), total_probe(solver));
+    if (solver->best_lb == claim_ub && solver->best_ub == claim_ub) {
+      solver->best_ub = plan_ub; // the claimed upper bound is refuted
+      claim_ub = INT_MAX;
+    }
+  }
+  if (solver->best_ub == claim_ub) {
+    solver->best_ub = plan_ub; // stopped before finding the claimed plan
+  }
+  adopt_ub(solver);
+  if (solver->best_lb < solver->best_ub) {
+    solver->checkpoint = snapshot(solver, inst, init_ub);
+  }
+  solver->resume = NULL;
+  debug_info(solver, "end", total_nodes(solver), total_probe(solver));
+
+  /*
+   * Report
+   */
+  report_t *report = new_report(
+      root_lb, init_ub, solver->best_lb, solver->best_ub, solver->best_sol,
+      solver->time_to_best_lb - solver->start_time,
+      solver->time_to_best_ub - solver->start_time,
+      now(solver) - solver->start_time, total_nodes(solver),
+      total_probe(solver));
+  for (int i = 0; i < solver->best_ub; i++) {
+    report->best_sol[i].p = solver->label[report->best_sol[i].p];
+  }
+  report->n_threads = solver->n_threads;
+  for (int i = 0; i < solver->n_threads; i++) {
+    report->n_steal += workers[i].n_steal;
+    report->n_table_lookup += workers[i].n_table_lookup;
+    report->n_table_hit += workers[i].n_table_hit;
+    report->n_table_cut += workers[i].n_table_cut;
+    report->n_table_store += workers[i].n_table_store;
+    report->n_table_reject += workers[i].n_table_reject;
+    for (int r = 0; r < N_RULES; r++) {
+      report->n_rule_cut[r] += workers[i].n_rule_cut[r];
+    }
+    add_stats(&report->stats, &workers[i].stats);
+  }
+  update_peak(solver);
+  report->peak_bytes = solver->peak_bytes;
+  report->table_bytes =
+      solver->table != NULL ? table_bytes(solver->table) : 0;
+  if (solver->profiling) {
+    report->n_iterations = solver->n_iterations;
+    report->n_levels = solver->capacity + 1;
+    report->profile = solver->profile;
+    report->bounds = solver->bounds;
+    solver->profile = NULL;
+    solver->bounds = NULL;
+  }
+  if (solver->events != NULL && solver->portfolio == NULL) {
+    print_report_json(solver->events, report);
+  }
+  return report;
+}
+
+run_status_t run_status(solver_t *solver) { return solver->status; }
+
+checkpoint_t *take_checkpoint(solver_t *solver) {
+  checkpoint_t *ckpt = solver->checkpoint;
+  solver->checkpoint = NULL;
+  return ckpt;
+}
+
+void interrupt_solver(solver_t *solver) {
+  __atomic_store_n(&solver->interrupted, true, __ATOMIC_RELAXED);
+}
+
+report_t *solve(instance_t *inst, int _t) {
+  return solve_parallel(inst, _t, 1);
+}
+
+report_t *solve_parallel(instance_t *inst, int _t, int _n) {
+  params_t params;
+  default_params(&params);
+  params.n_threads = _n;
+  solver_t *solver = malloc_solver(inst->n_stacks, inst->n_tiers, &params);
+  report_t *report = run_solver(solver, inst, _t);
+  free_solver(solver);
+  return report;
+}
+
+/*
+ * Portfolio
+ */
+portfolio_t *malloc_portfolio(int n_stacks, int n_tiers, params_t *configs,
+                              int n_configs) {
+  portfolio_t *portfolio = malloc(sizeof(portfolio_t));
+  portfolio->n_solvers = n_configs;
+  portfolio->solvers = malloc(sizeof(solver_t *) * n_configs);
+  portfolio->events = configs[0].events;
+  for (int i = 0; i < n_configs; i++) {
+    solver_t *solver = malloc_solver(n_stacks, n_tiers, &configs[i]);
+    solver->wall_clock = true;
+    solver->concurrent = true;
+    solver->portfolio = portfolio;
+    solver->member = i;
+    portfolio->solvers[i] = solver;
+  }
+  portfolio->best_sol = NULL;
+  portfolio->reports = malloc(sizeof(report_t *) * n_configs);
+  pthread_mutex_init(&portfolio->lock, NULL);
+  return portfolio;
+}
+
+void free_portfolio(portfolio_t *portfolio) {
+  for (int i = 0; i < portfolio->n_solvers; i++) {
+    free_solver(portfolio->solvers[i]);
+  }
+  free(portfolio->solvers);
+  free(portfolio->best_sol);
+  free(portfolio->reports);
+  pthread_mutex_destroy(&portfolio->lock);
+  free(portfolio);
+}
+
+static void *run_member(void *arg) {
+  solver_t *solver = arg;
+  portfolio_t *p = solver->portfolio;
+  report_t *report = run_solver_warm(solver, p->inst, p->time_limit, p->warm);
+  p->reports[solver->member] = report;
+  if (report == NULL || report->best_lb < report->best_ub) {
+    return NULL;
   }
-  debug_info("end");
 
   /*
-   * Free temporary variables
+   * The first solver to close the gap stops the others
    */
-  free_state(root_state);
-  free_state(probe_state);
-  free(array_s1);
-  free(array_s2);
-  free(array_s3);
-  free(array_t1);
-  free(path);
-  for (int i = 1; i <= max_depth; i++) {
-    free_state(hist[i].state);
+  pthread_mutex_lock(&p->lock);
+  bool first = p->winner < 0;
+  if (first) {
+    p->winner = solver->member;
+  }
+  pthread_mutex_unlock(&p->lock);
+  for (int i = 0; first && i < p->n_solvers; i++) {
+    if (i != solver->member) {
+      interrupt_solver(p->solvers[i]);
+      stop(p->solvers[i]);
+    }
   }
-  free(hist);
-  free_state(temp_state);
-  for (int i = 0; i < max_depth * (n_stacks - 1); i++) {
-    free_state(pool[i].child_state);
+  return NULL;
+}
+
+report_t *run_portfolio(portfolio_t *portfolio, instance_t *inst, int _t,
+                        warm_start_t *warm) {
+  portfolio_t *p = portfolio;
+  warm_start_t bounds;
+  if (warm != NULL && warm->resume != NULL) {
+    fprintf(stderr, "Checkpoint is not resumed by a portfolio\n");
+    bounds = *warm;
+    bounds.resume = NULL;
+    warm = &bounds;
   }
-  free(pool);
+  p->inst = inst;
+  p->time_limit = _t;
+  p->warm = warm;
+  p->best_lb = 0;
+  p->best_ub = INT_MAX;
+  p->lb_solver = -1;
+  p->ub_solver = -1;
+  p->winner = -1;
+  p->start_time = get_wall_time();
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * p->n_solvers);
+  for (int i = 0; i < p->n_solvers; i++) {
+    p->solvers[i]->interrupted = false;
+  }
+  for (int i = 0; i < p->n_solvers; i++) {
+    pthread_create(&threads[i], NULL, run_member, p->solvers[i]);
+  }
+  for (int i = 0; i < p->n_solvers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
 
   /*
-   * Report
+   * Report of the winner, or of the best lower bound if none, with the best
+   * solution of all solvers and the counters of all of them
    */
-  report_t *report =
-      new_report(root_lb, max_depth, best_lb, best_ub, best_sol,
-                 time_to_best_lb - start_time, time_to_best_ub - start_time,
-                 get_time() - start_time, n_nodes, n_probe);
-  free(best_sol);
+  int k = p->winner;
+  for (int i = 0; p->winner < 0 && i < p->n_solvers; i++) {
+    if (p->reports[i] != NULL &&
+        (k < 0 || p->reports[i]->best_lb > p->reports[k]->best_lb)) {
+      k = i;
+    }
+  }
+  if (k < 0) {
+    return NULL;
+  }
+  report_t *report = p->reports[k];
+  for (int i = 0; i < p->n_solvers; i++) {
+    report_t *other = p->reports[i];
+    if (i == k || other == NULL) {
+      continue;
+    }
+    if (other->best_sol != NULL && other->best_ub < report->best_ub) {
+      free(report->best_sol);
+      report->best_sol = other->best_sol;
+      report->best_ub = other->best_ub;
+      report->time_to_best_ub = other->time_to_best_ub;
+      other->best_sol = NULL;
+    }
+    report->n_nodes += other->n_nodes;
+    report->n_probe += other->n_probe;
+    report->n_threads += other->n_threads;
+    report->n_steal += other->n_steal;
+    report->n_table_lookup += other->n_table_lookup;
+    report->n_table_hit += other->n_table_hit;
+    report->n_table_cut += other->n_table_cut;
+    report->n_table_store += other->n_table_store;
+    report->n_table_reject += other->n_table_reject;
+    report->table_bytes += other->table_bytes;
+    report->peak_bytes += other->peak_bytes;
+    for (int r = 0; r < N_RULES; r++) {
+      report->n_rule_cut[r] += other->n_rule_cut[r];
+    }
+    add_stats(&report->stats, &other->stats);
+    free_report(other);
+  }
+  report->n_configs = p->n_solvers;
+  report->winner = p->winner;
+  report->lb_config = p->lb_solver;
+  report->ub_config = p->ub_solver;
+  if (p->events != NULL) {
+    print_report_json(p->events, report);
+  }
   return report;
 }
+
+void interrupt_portfolio(portfolio_t *portfolio) {
+  for (int i = 0; i < portfolio->n_solvers; i++) {
+    interrupt_solver(portfolio->solvers[i]);
+  }
+}
@@ -18,8 +18,162 @@
 #ifndef ALGORITHM_H
 #define ALGORITHM_H
 
+#include "checkpoint.h"
 #include "instance.h"
 #include "report.h"
+#include "transposition.h"
+#include <stdbool.h>
+
+/*
+ * Orders of the branches of a node, which all come first by child lower bound
+ * and differ in how ties are broken
+ */
+typedef enum {
+  ORDER_HIGH,  // highest destination quality first
+  ORDER_LOW,   // lowest destination quality first
+  ORDER_LEFT,  // leftmost destination first
+  ORDER_RIGHT, // rightmost destination first
+  N_ORDERS
+} order_t;
+
+/*
+ * Names of the branch orders, as used on command lines
+ */
+extern const char *order_names[N_ORDERS];
+
+typedef struct {
+  int n_threads;   // number of search threads
+  bool verbose;    // true if printing progress information to stdout
+  FILE *events;    // stream of JSON-lines progress events, NULL if none
+  bool wall_clock; // true if measuring wall-clock time instead of CPU time
+  size_t table_bytes;    // memory of the transposition table, 0 if disabled
+  policy_t table_policy; // replacement policy of the transposition table
+  bool specialized;      // true if using kernels specialized for the shape
+  bool profile;          // true if profiling nodes per iteration and level
+  bool iterative;        // true if searching with an explicit stack
+  size_t memory_bytes;   // memory budget of the solver, 0 if unlimited
+  unsigned rules;        // enabled dominance rules, bit r for rule r
+  order_t order;         // order of the branches of a node
+  int probe_slack;       // largest slack of the probed children, 0 if none
+} params_t;
+
+/**
+ * Reentrant solver owning all the space needed by the search. It can be
+ * reused for any number of instances with the same dimensions, and different
+ * solvers can run concurrently in separate threads.
+ */
+typedef struct solver solver_t;
+
+/*
+ * Set of all dominance rules
+ */
+#define ALL_RULES ((1u << N_RULES) - 1)
+
+/**
+ * Set default parameters, i.e., a single verbose thread measuring CPU time
+ * with specialized kernels, the recursive search and all dominance rules,
+ * branches by highest destination quality among equal bounds, probes of the
+ * children one below the threshold, and without event stream, transposition
+ * table or profiling
+ *
+ * @param params the parameters
+ */
+void default_params(params_t *params);
+
+/**
+ * Create a solver. Only the space of the root is allocated up front, and the
+ * space of the search grows with the deepening threshold. When the memory
+ * budget does not allow a child head per branch, branches switch to compact
+ * ones that regenerate their children on descent, and a run that does not
+ * fit even so stops as if its time limit were reached.
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @param params solver parameters
+ * @return created solver
+ */
+solver_t *malloc_solver(int n_stacks, int n_tiers, params_t *params);
+
+/**
+ * Free the space of a solver
+ *
+ * @param solver the solver
+ */
+void free_solver(solver_t *solver);
+
+/**
+ * Solve an instance by a solver, where the space grows only when the instance
+ * needs a deeper search than any previous one
+ *
+ * @param solver the solver
+ * @param inst instance to be solved, which must match the solver dimensions
+ * @param _t time limit in seconds
+ * @return solution report, or NULL if none, whose reason is given by
+ *         run_status
+ */
+report_t *run_solver(solver_t *solver, instance_t *inst, int _t);
+
+typedef enum {
+  RUN_REPORTED,   // a report is returned
+  RUN_INFEASIBLE, // the instance has no restricted solution
+  RUN_UNFIT,      // priorities or search depth do not fit in the cells
+  RUN_MISMATCH    // the instance does not match the solver dimensions
+} run_status_t;
+
+/**
+ * Get the outcome of the last run of a solver, which tells why no report is
+ * returned
+ *
+ * @param solver the solver
+ * @return outcome of the last run
+ */
+run_status_t run_status(solver_t *solver);
+
+typedef struct {
+  move_t *sol;          // solution with original priorities, NULL if none
+  int len;              // length of the solution
+  int lb;               // proven lower bound, 0 if none
+  int ub;               // claimed upper bound without a plan, 0 if none
+  checkpoint_t *resume; // checkpoint of an interrupted run, NULL if none
+} warm_start_t;
+
+/**
+ * Solve an instance by a solver warm-started from an external solution or
+ * bounds. A solution is replayed and ignored with a warning unless it is a
+ * valid restricted solution; otherwise it seeds the incumbent and the search
+ * depth. The lower bound is trusted as proven and skips the iterations below
+ * it, while the upper bound only tightens the probes until it is met by a
+ * plan or refuted by the search. A checkpoint taken from the same instance
+ * overrides the solution and the lower bound, and the run continues its
+ * iteration, clock and counters where it was interrupted.
+ *
+ * @param solver the solver
+ * @param inst instance to be solved, which must match the solver dimensions
+ * @param _t time limit in seconds
+ * @param warm warm-start solution and bounds, NULL if none
+ * @return solution report, or NULL if none, whose reason is given by
+ *         run_status
+ */
+report_t *run_solver_warm(solver_t *solver, instance_t *inst, int _t,
+                          warm_start_t *warm);
+
+/**
+ * Take the checkpoint of the last run of a solver, which exists only if the
+ * run is stopped by the time limit or by interrupt_solver before proving
+ * optimality
+ *
+ * @param solver the solver
+ * @return checkpoint owned by the caller, or NULL if none
+ */
+checkpoint_t *take_checkpoint(solver_t *solver);
+
+/**
+ * Stop the current run of a solver as if its time limit were reached. It is
+ * safe to call from a signal handler.
+ *
+ * @param solver the solver
+ */
+void interrupt_solver(solver_t *solver);
 
 /**
  * Solve an instance by iterative deepening branch-and-bound
@@ -30,4 +184,69 @@
  */
 report_t *solve(instance_t *inst, int _t);
 
+/**
+ * Solve an instance by iterative deepening branch-and-bound on multiple
+ * threads. The subtrees below the root are shared by work stealing, and the
+ * incumbent is shared by all threads. Wall-clock time is used when more than
+ * one thread is requested.
+ *
+ * @param inst instance to be solved
+ * @param _t time limit in seconds
+ * @param _n number of threads
+ * @return solution report
+ */
+report_t *solve_parallel(instance_t *inst, int _t, int _n);
+
+/**
+ * Portfolio of solvers with different configurations, which search the same
+ * instance concurrently in separate threads
+ */
+typedef struct portfolio portfolio_t;
+
+/**
+ * Create a portfolio with one solver per configuration, where each solver
+ * measures wall-clock time
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @param configs parameters of the solvers
+ * @param n_configs number of configurations
+ * @return created portfolio
+ */
+portfolio_t *malloc_portfolio(int n_stacks, int n_tiers, params_t *configs,
+                              int n_configs);
+
+/**
+ * Free the space of a portfolio and its solvers
+ *
+ * @param portfolio the portfolio
+ */
+void free_portfolio(portfolio_t *portfolio);
+
+/**
+ * Solve an instance by all solvers of a portfolio at once. The solvers share
+ * the incumbent at any time and their proven lower bounds between iterations,
+ * and the first one to close the gap stops the others. The report is the one
+ * of that solver, or of the one with the best lower bound if none closes the
+ * gap, with the counters summed over all solvers and the configurations that
+ * closed the gap, proved the lower bound and found the solution. No
+ * checkpoint is taken or resumed.
+ *
+ * @param portfolio the portfolio
+ * @param inst instance to be solved, which must match the solver dimensions
+ * @param _t time limit in seconds
+ * @param warm warm-start solution and bounds, NULL if none
+ * @return solution report
+ */
+report_t *run_portfolio(portfolio_t *portfolio, instance_t *inst, int _t,
+                        warm_start_t *warm);
+
+/**
+ * Stop the current run of a portfolio as if its time limit were reached. It
+ * is safe to call from a signal handler.
+ *
+ * @param portfolio the portfolio
+ */
+void interrupt_portfolio(portfolio_t *portfolio);
+
 #endif
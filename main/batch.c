@@ -0,0 +1,493 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "algorithm.h"
+#include "timer.h"
+#include <dirent.h>
+#include <getopt.h>
+#include <glob.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+typedef struct {
+  int n_stacks;
+  int n_tiers;
+  solver_t *solver;
+} cached_solver_t;
+
+typedef struct {
+  char *name;       // file name, or archive name with the instance number
+  instance_t *inst; // instance parsed from an archive, NULL if not yet read
+  long index;       // index in the binary archive, -1 if not in it
+} item_t;
+
+/*
+ * Shared by all workers
+ */
+static item_t *items;
+static int n_items;
+static int next_item;
+static int time_limit;
+static bool json;
+static bool specialized = true;
+static FILE *output;
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static archive_t *binary;
+static bool store;
+static pthread_mutex_t binary_lock = PTHREAD_MUTEX_INITIALIZER;
+static int n_ran;
+static int n_optimal;
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-batch -h\n");
+  fprintf(stdout, "usage: main-batch"
+                  " --input/-i directory_or_glob"
+                  " --manifest/-m manifest_file"
+                  " --archive/-a archive_file"
+                  " --binary/-b binary_archive"
+                  " --first/-f first"
+                  " --count/-c count"
+                  " --time_limit/-t time_limit"
+                  " --workers/-w n_workers"
+                  " --output/-o output_file"
+                  " [--json/-j]"
+                  " [--store/-s]"
+                  " [--generic/-g]\n");
+  fprintf(stdout, "\t--input/-i: directory or glob pattern of input files,"
+                  " which can be repeated\n");
+  fprintf(stdout, "\t--manifest/-m: file listing one input file per line,"
+                  " which can be repeated\n");
+  fprintf(stdout, "\t--archive/-a: file of concatenated instances, which can"
+                  " be repeated\n");
+  fprintf(stdout, "\t--binary/-b: binary archive written by main-convert\n");
+  fprintf(stdout, "\t--first/-f: index of the first instance of the binary"
+                  " archive to solve, from 0\n");
+  fprintf(stdout, "\t--count/-c: number of instances of the binary archive"
+                  " to solve (all by default)\n");
+  fprintf(stdout, "\t--store/-s: store the reports into the binary"
+                  " archive\n");
+  fprintf(stdout, "\t--time_limit/-t: time limit per instance in seconds\n");
+  fprintf(stdout, "\t--workers/-w: number of worker threads\n");
+  fprintf(stdout, "\t--output/-o: result file (stdout by default)\n");
+  fprintf(stdout, "\t--json/-j: write JSON lines instead of CSV\n");
+  fprintf(stdout, "\t--generic/-g: use generic kernels for all bay shapes\n");
+  fflush(stdout);
+}
+
+/*
+ * Input files
+ */
+static void add_item(const char *name, instance_t *inst, long index) {
+  if (n_items % 64 == 0) {
+    items = realloc(items, sizeof(item_t) * (n_items + 64));
+  }
+  items[n_items].name = strcpy(malloc(strlen(name) + 1), name);
+  items[n_items].inst = inst;
+  items[n_items].index = index;
+  n_items++;
+}
+
+static void add_file(const char *file) {
+  add_item(file, NULL, -1);
+}
+
+static int compare_name(const void *a, const void *b) {
+  return strcmp(((item_t *)a)->name, ((item_t *)b)->name);
+}
+
+static bool add_directory(const char *dir) {
+  DIR *dp = opendir(dir);
+  if (dp == NULL) {
+    fprintf(stderr, "Failed to open directory: %s\n", dir);
+    return false;
+  }
+  int first = n_items;
+  for (struct dirent *ep; (ep = readdir(dp)) != NULL;) {
+    char *file = malloc(strlen(dir) + strlen(ep->d_name) + 2);
+    sprintf(file, "%s/%s", dir, ep->d_name);
+    struct stat sb;
+    if (stat(file, &sb) == 0 && S_ISREG(sb.st_mode)) {
+      add_file(file);
+    }
+    free(file);
+  }
+  closedir(dp);
+  qsort(items + first, n_items - first, sizeof(item_t), compare_name);
+  return true;
+}
+
+static bool add_input(const char *input) {
+  struct stat sb;
+  if (stat(input, &sb) == 0 && S_ISDIR(sb.st_mode)) {
+    return add_directory(input);
+  }
+  glob_t g;
+  if (glob(input, 0, NULL, &g) != 0) {
+    fprintf(stderr, "No input file matches: %s\n", input);
+    return false;
+  }
+  for (size_t i = 0; i < g.gl_pathc; i++) {
+    add_file(g.gl_pathv[i]);
+  }
+  globfree(&g);
+  return true;
+}
+
+static bool add_manifest(const char *manifest) {
+  FILE *fp = fopen(manifest, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", manifest);
+    return false;
+  }
+  char buf[BUFSIZ];
+  while (fgets(buf, BUFSIZ, fp) != NULL) {
+    char *iter = buf + strspn(buf, " \t");
+    iter[strcspn(iter, "\r\n")] = '\0';
+    if (*iter != '#' && *iter != '\0') {
+      add_file(iter);
+    }
+  }
+  fclose(fp);
+  return true;
+}
+
+/*
+ * Archives are parsed up front, so that the parse rate is measured apart from
+ * the search
+ */
+static bool add_archive(const char *archive) {
+  double start_time = get_wall_time();
+  instance_reader_t *reader = open_instances(archive);
+  if (reader == NULL) {
+    return false;
+  }
+  char *name = malloc(strlen(archive) + 32);
+  instance_t *inst;
+  bool ok;
+  while ((ok = next_instance(reader, &inst)) && inst != NULL) {
+    sprintf(name, "%s#%ld", archive, reader->n_instances - 1);
+    add_item(name, inst, -1);
+  }
+  double time_used = get_wall_time() - start_time;
+  fprintf(stderr,
+          "[parse] %s: instances = %ld / size = %.1f MB / time = %.3f / "
+          "rate = %.0f instances/s, %.1f MB/s\n",
+          archive, reader->n_instances, reader->size / 1048576.0, time_used,
+          time_used > 0 ? reader->n_instances / time_used : 0.0,
+          time_used > 0 ? reader->size / 1048576.0 / time_used : 0.0);
+  free(name);
+  close_instances(reader);
+  return ok;
+}
+
+/*
+ * Instances of the binary archive are loaded by the workers on demand
+ */
+static bool add_binary(const char *archive, bool writable, long first,
+                       long count) {
+  binary = open_archive(archive, writable);
+  if (binary == NULL) {
+    return false;
+  }
+  long last = count < 0 || first + count > binary->n_instances
+                  ? binary->n_instances
+                  : first + count;
+  char *name = malloc(strlen(archive) + 32);
+  for (long k = first < 0 ? 0 : first; k < last; k++) {
+    sprintf(name, "%s#%ld", archive, k);
+    add_item(name, NULL, k);
+  }
+  free(name);
+  return true;
+}
+
+static instance_t *load_item(item_t *item) {
+  if (item->inst != NULL) {
+    instance_t *inst = item->inst;
+    item->inst = NULL;
+    return inst;
+  }
+  if (item->index < 0) {
+    return read_instance(item->name);
+  }
+  pthread_mutex_lock(&binary_lock);
+  instance_t *inst = load_instance(binary, item->index);
+  pthread_mutex_unlock(&binary_lock);
+  return inst;
+}
+
+/*
+ * Results
+ */
+static const char *status_of(instance_t *inst, solver_t *solver,
+                             report_t *report) {
+  if (inst == NULL) {
+    return "unreadable";
+  }
+  if (report == NULL) {
+    bool infeasible = solver != NULL && run_status(solver) == RUN_INFEASIBLE;
+    return infeasible ? "infeasible" : "unsolved";
+  }
+  return report->best_lb == report->best_ub ? "optimal" : "timeout";
+}
+
+static void print_header(void) {
+  if (!json) {
+    fprintf(output, "file,status,init_lb,init_ub,best_lb,best_ub,"
+                    "time_to_best_lb,time_to_best_ub,time_used,nodes,probe\n");
+  }
+}
+
+static void print_json_string(const char *str) {
+  fputc('"', output);
+  for (const char *c = str; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(output, "\\%c", *c);
+    } else if ((unsigned char)*c < 0x20) {
+      fprintf(output, "\\u%04x", (unsigned char)*c);
+    } else {
+      fputc(*c, output);
+    }
+  }
+  fputc('"', output);
+}
+
+static void print_row(const char *file, instance_t *inst, solver_t *solver,
+                      report_t *report) {
+  const char *status = status_of(inst, solver, report);
+  if (json) {
+    fprintf(output, "{\"file\": ");
+    print_json_string(file);
+  }
+  if (report == NULL) {
+    if (json) {
+      fprintf(output, ", \"status\": \"%s\"}\n", status);
+    } else {
+      fprintf(output, "%s,%s,,,,,,,,,\n", file, status);
+    }
+  } else if (json) {
+    fprintf(output,
+            ", \"status\": \"%s\", \"init_lb\": %d, "
+            "\"init_ub\": %d, \"best_lb\": %d, \"best_ub\": %d, "
+            "\"time_to_best_lb\": %.3f, \"time_to_best_ub\": %.3f, "
+            "\"time_used\": %.3f, \"nodes\": %ld, \"probe\": %ld}\n",
+            status, report->init_lb, report->init_ub, report->best_lb,
+            report->best_ub, report->time_to_best_lb, report->time_to_best_ub,
+            report->time_used, report->n_nodes, report->n_probe);
+  } else {
+    fprintf(output, "%s,%s,%d,%d,%d,%d,%.3f,%.3f,%.3f,%ld,%ld\n", file, status,
+            report->init_lb, report->init_ub, report->best_lb, report->best_ub,
+            report->time_to_best_lb, report->time_to_best_ub,
+            report->time_used, report->n_nodes, report->n_probe);
+  }
+  fflush(output);
+}
+
+/*
+ * Workers, each keeping one solver per bay dimensions
+ */
+static solver_t *find_solver(cached_solver_t **cache, int *size,
+                             instance_t *inst) {
+  for (int i = 0; i < *size; i++) {
+    if ((*cache)[i].n_stacks == inst->n_stacks &&
+        (*cache)[i].n_tiers == inst->n_tiers) {
+      return (*cache)[i].solver;
+    }
+  }
+
+  params_t params;
+  default_params(&params);
+  params.verbose = false;
+  params.wall_clock = true;
+  params.specialized = specialized;
+
+  *cache = realloc(*cache, sizeof(cached_solver_t) * (*size + 1));
+  cached_solver_t *entry = &(*cache)[(*size)++];
+  entry->n_stacks = inst->n_stacks;
+  entry->n_tiers = inst->n_tiers;
+  entry->solver = malloc_solver(inst->n_stacks, inst->n_tiers, &params);
+  return entry->solver;
+}
+
+static void *work(void *arg) {
+  (void)arg;
+  cached_solver_t *cache = NULL;
+  int size = 0;
+
+  for (int i; (i = __atomic_fetch_add(&next_item, 1, __ATOMIC_RELAXED)) <
+              n_items;) {
+    instance_t *inst = load_item(&items[i]);
+    solver_t *solver = inst == NULL ? NULL : find_solver(&cache, &size, inst);
+    report_t *report =
+        solver == NULL ? NULL : run_solver(solver, inst, time_limit);
+
+    pthread_mutex_lock(&output_lock);
+    print_row(items[i].name, inst, solver, report);
+    n_ran += report != NULL;
+    n_optimal += report != NULL && report->best_lb == report->best_ub;
+    pthread_mutex_unlock(&output_lock);
+
+    if (store && report != NULL && items[i].index >= 0) {
+      pthread_mutex_lock(&binary_lock);
+      if (!store_report(binary, items[i].index, report)) {
+        fprintf(stderr, "Failed to store report of: %s\n", items[i].name);
+      }
+      pthread_mutex_unlock(&binary_lock);
+    }
+
+    if (report != NULL) {
+      free_report(report);
+    }
+    if (inst != NULL) {
+      free_instance(inst);
+    }
+  }
+
+  for (int i = 0; i < size; i++) {
+    free_solver(cache[i].solver);
+  }
+  free(cache);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hi:m:a:b:f:c:t:w:o:jsg";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"input", required_argument, NULL, 'i'},
+                             {"manifest", required_argument, NULL, 'm'},
+                             {"archive", required_argument, NULL, 'a'},
+                             {"binary", required_argument, NULL, 'b'},
+                             {"first", required_argument, NULL, 'f'},
+                             {"count", required_argument, NULL, 'c'},
+                             {"store", no_argument, NULL, 's'},
+                             {"time_limit", required_argument, NULL, 't'},
+                             {"workers", required_argument, NULL, 'w'},
+                             {"output", required_argument, NULL, 'o'},
+                             {"json", no_argument, NULL, 'j'},
+                             {"generic", no_argument, NULL, 'g'},
+                             {NULL, 0, NULL, 0}};
+
+  int n_workers = 1;
+  char *output_file = NULL;
+  char *binary_file = NULL;
+  long first = 0;
+  long count = -1;
+  time_limit = 60;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'i':
+      if (!add_input(optarg)) {
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'm':
+      if (!add_manifest(optarg)) {
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'a':
+      if (!add_archive(optarg)) {
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'b':
+      binary_file = optarg;
+      break;
+    case 'f':
+      first = strtol(optarg, NULL, 10);
+      break;
+    case 'c':
+      count = strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      store = true;
+      break;
+    case 't':
+      time_limit = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'w':
+      n_workers = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'j':
+      json = true;
+      break;
+    case 'g':
+      specialized = false;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (binary_file != NULL && !add_binary(binary_file, store, first, count)) {
+    return EXIT_FAILURE;
+  }
+  if (n_items == 0) {
+    fprintf(stderr, "No input file is given\n");
+    return EXIT_FAILURE;
+  }
+  if (n_workers < 1) {
+    n_workers = 1;
+  }
+
+  output = output_file == NULL ? stdout : fopen(output_file, "w");
+  if (output == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", output_file);
+    return EXIT_FAILURE;
+  }
+  print_header();
+
+  double start_time = get_wall_time();
+  pthread_t *threads = malloc(sizeof(pthread_t) * n_workers);
+  for (int i = 0; i < n_workers; i++) {
+    pthread_create(&threads[i], NULL, work, NULL);
+  }
+  for (int i = 0; i < n_workers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  double time_used = get_wall_time() - start_time;
+  free(threads);
+
+  fprintf(stderr,
+          "instances = %d / ran = %d / optimal = %d (%.1f%%) / "
+          "time = %.3f / throughput = %.2f instances/s\n",
+          n_items, n_ran, n_optimal, 100.0 * n_optimal / n_items, time_used,
+          time_used > 0 ? n_items / time_used : 0.0);
+
+  if (output != stdout) {
+    fclose(output);
+  }
+  if (binary != NULL && !close_archive(binary)) {
+    fprintf(stderr, "Failed to write index of archive: %s\n", binary_file);
+  }
+  for (int i = 0; i < n_items; i++) {
+    free(items[i].name);
+  }
+  free(items);
+
+  return EXIT_SUCCESS;
+}
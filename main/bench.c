@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "algorithm.h"
+#include "generator.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  const char *name;      // class name
+  int n_instances;       // number of instances
+  int n_optimal;         // number of instances solved to optimality
+  int n_timeout;         // number of instances stopped by the time limit
+  int n_unsolved;        // number of instances the solver could not run
+  long sum_ub;           // sum of the best upper bounds
+  long n_nodes;          // number of nodes explored
+  long n_probe;          // number of nodes probed
+  double time_used;      // total time used in seconds
+  double time_to_ub;     // mean time to the best upper bound
+  double time_to_opt;    // mean time to optimality over the optimal instances
+  double nodes_per_sec;  // throughput
+} result_t;
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-bench -h\n");
+  fprintf(stdout, "usage: main-bench"
+                  " --class/-c class"
+                  " --instances/-n n_instances"
+                  " --seed/-s seed"
+                  " --time_limit/-t time_limit"
+                  " --output/-o output_file"
+                  " --baseline/-b baseline_file"
+                  " --tolerance/-r tolerance"
+                  " [--generic/-g]"
+                  " [--iterative/-I]\n");
+  fprintf(stdout, "\t--class/-c: instance class, which can be repeated"
+                  " (all standard classes by default)\n");
+  fprintf(stdout, "\t--instances/-n: number of instances per class\n");
+  fprintf(stdout, "\t--seed/-s: random seed of the instances\n");
+  fprintf(stdout, "\t--time_limit/-t: time limit per instance in seconds\n");
+  fprintf(stdout, "\t--output/-o: result file (stdout by default)\n");
+  fprintf(stdout, "\t--baseline/-b: result file of a previous run to compare"
+                  " with\n");
+  fprintf(stdout, "\t--tolerance/-r: relative loss of nodes/s reported as a"
+                  " regression\n");
+  fprintf(stdout, "\t--generic/-g: use generic kernels for all bay shapes\n");
+  fprintf(stdout, "\t--iterative/-I: search with an explicit stack instead"
+                  " of recursion\n");
+  fprintf(stdout, "classes:\n");
+  fprintf(stdout, "\tcv-height-stacks, cv-stacks-tiers-blocks or"
+                  " bf-stacks-tiers-blocks, optionally followed by -sorted,"
+                  " -sorted with a disorder such as -sorted0.4, or"
+                  " -adversarial\n");
+  fprintf(stdout, "standard classes:\n");
+  for (int i = 0; i < n_standard_classes; i++) {
+    const instance_class_t *cls = &standard_classes[i];
+    fprintf(stdout, "\t%-12s %s, %d stacks, %d tiers, %d blocks\n", cls->name,
+            cls->family == FAMILY_CV ? "CV" : "BF", cls->n_stacks,
+            cls->n_tiers, cls->n_blocks);
+  }
+  fflush(stdout);
+}
+
+static void run_class(const instance_class_t *cls, int n_instances,
+                      uint64_t seed, int time_limit, params_t *params,
+                      result_t *result) {
+  memset(result, 0, sizeof(result_t));
+  result->name = cls->name;
+  result->n_instances = n_instances;
+
+  solver_t *solver = malloc_solver(cls->n_stacks, cls->n_tiers, params);
+  for (int i = 0; i < n_instances; i++) {
+    instance_t *inst = generate_instance(cls, seed + i);
+    report_t *report = run_solver(solver, inst, time_limit);
+    if (report == NULL) {
+      result->n_unsolved++;
+      free_instance(inst);
+      continue;
+    }
+    if (report->best_lb == report->best_ub) {
+      result->n_optimal++;
+      result->time_to_opt += report->time_used;
+    } else {
+      result->n_timeout++;
+    }
+    result->sum_ub += report->best_ub;
+    result->n_nodes += report->n_nodes;
+    result->n_probe += report->n_probe;
+    result->time_used += report->time_used;
+    result->time_to_ub += report->time_to_best_ub;
+    free_report(report);
+    free_instance(inst);
+  }
+  free_solver(solver);
+
+  int n_solved = result->n_optimal + result->n_timeout;
+  result->time_to_ub /= n_solved > 0 ? n_solved : 1;
+  result->time_to_opt /= result->n_optimal > 0 ? result->n_optimal : 1;
+  result->nodes_per_sec =
+      result->time_used > 0 ? result->n_nodes / result->time_used : 0.0;
+}
+
+static void print_result(FILE *fp, result_t *result) {
+  fprintf(fp,
+          "{\"class\": \"%s\", \"instances\": %d, \"optimal\": %d, "
+          "\"timeout\": %d, \"unsolved\": %d, \"sum_ub\": %ld, "
+          "\"nodes\": %ld, \"probe\": %ld, \"time_used\": %.3f, "
+          "\"time_to_best_ub\": %.3f, \"time_to_optimal\": %.3f, "
+          "\"nodes_per_sec\": %.0f}\n",
+          result->name, result->n_instances, result->n_optimal,
+          result->n_timeout, result->n_unsolved, result->sum_ub,
+          result->n_nodes, result->n_probe, result->time_used,
+          result->time_to_ub, result->time_to_opt, result->nodes_per_sec);
+  fflush(fp);
+}
+
+/*
+ * Baseline, i.e., the lines written by print_result in a previous run
+ */
+static bool parse_field(const char *line, const char *key, double *value) {
+  char pattern[64];
+  sprintf(pattern, "\"%s\": ", key);
+  const char *iter = strstr(line, pattern);
+  if (iter == NULL) {
+    return false;
+  }
+  *value = strtod(iter + strlen(pattern), NULL);
+  return true;
+}
+
+static bool find_baseline(FILE *fp, const char *name, double *nodes,
+                          double *sum_ub, double *nodes_per_sec) {
+  char pattern[64];
+  sprintf(pattern, "\"class\": \"%s\"", name);
+  char buf[BUFSIZ];
+  rewind(fp);
+  while (fgets(buf, BUFSIZ, fp) != NULL) {
+    if (strstr(buf, pattern) != NULL) {
+      return parse_field(buf, "nodes", nodes) &&
+             parse_field(buf, "sum_ub", sum_ub) &&
+             parse_field(buf, "nodes_per_sec", nodes_per_sec);
+    }
+  }
+  return false;
+}
+
+static int compare(FILE *fp, result_t *results, int n_results,
+                   double tolerance) {
+  int n_regression = 0;
+  fprintf(stderr, "%-12s %14s %14s %8s  %s\n", "class", "nodes/s",
+          "baseline", "ratio", "status");
+  for (int i = 0; i < n_results; i++) {
+    result_t *result = &results[i];
+    double nodes, sum_ub, nodes_per_sec;
+    if (!find_baseline(fp, result->name, &nodes, &sum_ub, &nodes_per_sec)) {
+      fprintf(stderr, "%-12s %14.0f %14s %8s  %s\n", result->name,
+              result->nodes_per_sec, "-", "-", "new");
+      continue;
+    }
+
+    double ratio =
+        nodes_per_sec > 0 ? result->nodes_per_sec / nodes_per_sec : 1.0;
+    const char *status = "ok";
+    if (ratio < 1 - tolerance) {
+      status = "REGRESSION";
+      n_regression++;
+    }
+    fprintf(stderr, "%-12s %14.0f %14.0f %8.3f  %s%s%s\n", result->name,
+            result->nodes_per_sec, nodes_per_sec, ratio, status,
+            (long)nodes != result->n_nodes ? ", nodes changed" : "",
+            (long)sum_ub != result->sum_ub ? ", solutions changed" : "");
+  }
+  return n_regression;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hc:n:s:t:o:b:r:gI";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"class", required_argument, NULL, 'c'},
+                             {"instances", required_argument, NULL, 'n'},
+                             {"seed", required_argument, NULL, 's'},
+                             {"time_limit", required_argument, NULL, 't'},
+                             {"output", required_argument, NULL, 'o'},
+                             {"baseline", required_argument, NULL, 'b'},
+                             {"tolerance", required_argument, NULL, 'r'},
+                             {"generic", no_argument, NULL, 'g'},
+                             {"iterative", no_argument, NULL, 'I'},
+                             {NULL, 0, NULL, 0}};
+
+  instance_class_t *classes = NULL;
+  int n_classes = 0;
+  int n_instances = 10;
+  uint64_t seed = 1;
+  int time_limit = 10;
+  char *output_file = NULL;
+  char *baseline_file = NULL;
+  double tolerance = 0.1;
+  params_t params;
+  default_params(&params);
+  params.verbose = false;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'c':
+      classes = realloc(classes, sizeof(instance_class_t) * (n_classes + 1));
+      if (!parse_class(optarg, &classes[n_classes++])) {
+        fprintf(stderr, "Unknown or infeasible class: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'n':
+      n_instances = (int)strtol(optarg, NULL, 10);
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 't':
+      time_limit = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'o':
+      output_file = optarg;
+      break;
+    case 'b':
+      baseline_file = optarg;
+      break;
+    case 'r':
+      tolerance = strtod(optarg, NULL);
+      break;
+    case 'g':
+      params.specialized = false;
+      break;
+    case 'I':
+      params.iterative = true;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (n_classes == 0) {
+    n_classes = n_standard_classes;
+    classes = malloc(sizeof(instance_class_t) * n_classes);
+    memcpy(classes, standard_classes, sizeof(instance_class_t) * n_classes);
+  }
+  if (n_instances < 1) {
+    n_instances = 1;
+  }
+
+  FILE *baseline = NULL;
+  if (baseline_file != NULL) {
+    baseline = fopen(baseline_file, "r");
+    if (baseline == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", baseline_file);
+      return EXIT_FAILURE;
+    }
+  }
+
+  FILE *output = output_file == NULL ? stdout : fopen(output_file, "w");
+  if (output == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", output_file);
+    return EXIT_FAILURE;
+  }
+
+  result_t *results = malloc(sizeof(result_t) * n_classes);
+  for (int i = 0; i < n_classes; i++) {
+    run_class(&classes[i], n_instances, seed, time_limit, &params,
+              &results[i]);
+    print_result(output, &results[i]);
+    fprintf(stderr,
+            "[%s] optimal = %d / timeout = %d / unsolved = %d / nodes = %ld / "
+            "time = %.3f / nodes/s = %.0f\n",
+            results[i].name, results[i].n_optimal, results[i].n_timeout,
+            results[i].n_unsolved, results[i].n_nodes, results[i].time_used,
+            results[i].nodes_per_sec);
+  }
+
+  int n_regression = 0;
+  if (baseline != NULL) {
+    n_regression = compare(baseline, results, n_classes, tolerance);
+    fclose(baseline);
+  }
+
+  if (output != stdout) {
+    fclose(output);
+  }
+  free(results);
+  free(classes);
+
+  return n_regression > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "checkpoint.h"
+#include "state.h"
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Version of the checkpoint format
+ */
+#define CHECKPOINT_VERSION 2
+
+uint64_t instance_fingerprint(instance_t *inst) {
+  uint64_t hash = mix_hash((uint64_t)inst->n_stacks << 32 ^
+                           (uint32_t)inst->n_tiers);
+  hash = mix_hash(hash ^ (uint32_t)inst->n_blocks);
+  for (int s = 0; s < inst->n_stacks; s++) {
+    hash = mix_hash(hash ^ (uint32_t)inst->h[s]);
+    for (int t = 1; t <= inst->h[s]; t++) {
+      hash = mix_hash(hash ^ (uint32_t)inst->p[s][t]);
+    }
+  }
+  return hash;
+}
+
+checkpoint_t *new_checkpoint(instance_t *inst, int best_ub, move_t *best_sol) {
+  checkpoint_t *ckpt = malloc(sizeof(checkpoint_t));
+  ckpt->n_stacks = inst->n_stacks;
+  ckpt->n_tiers = inst->n_tiers;
+  ckpt->n_blocks = inst->n_blocks;
+  ckpt->fingerprint = instance_fingerprint(inst);
+  ckpt->init_ub = best_ub;
+  ckpt->best_lb = 0;
+  ckpt->best_ub = best_ub;
+  ckpt->best_sol = memcpy(malloc(sizeof(move_t) * (best_ub > 0 ? best_ub : 1)),
+                          best_sol, sizeof(move_t) * best_ub);
+  ckpt->time_used = 0;
+  ckpt->time_to_best_lb = 0;
+  ckpt->time_to_best_ub = 0;
+  ckpt->n_nodes = 0;
+  ckpt->n_probe = 0;
+  ckpt->rules = 0;
+  ckpt->n_paths = 0;
+  ckpt->paths = NULL;
+  return ckpt;
+}
+
+void add_resume_path(checkpoint_t *ckpt, int depth, int *dst, int *next) {
+  ckpt->paths =
+      realloc(ckpt->paths, sizeof(resume_path_t) * (ckpt->n_paths + 1));
+  resume_path_t *path = &ckpt->paths[ckpt->n_paths++];
+  path->depth = depth;
+  path->dst = malloc(sizeof(int) * (depth > 0 ? depth : 1));
+  path->next = malloc(sizeof(int) * (depth > 0 ? depth : 1));
+  memcpy(path->dst, dst, sizeof(int) * depth);
+  memcpy(path->next, next, sizeof(int) * depth);
+}
+
+void free_checkpoint(checkpoint_t *ckpt) {
+  for (int k = 0; k < ckpt->n_paths; k++) {
+    free(ckpt->paths[k].dst);
+    free(ckpt->paths[k].next);
+  }
+  free(ckpt->paths);
+  free(ckpt->best_sol);
+  free(ckpt);
+}
+
+bool match_checkpoint(checkpoint_t *ckpt, instance_t *inst) {
+  return ckpt->n_stacks == inst->n_stacks && ckpt->n_tiers == inst->n_tiers &&
+         ckpt->n_blocks == inst->n_blocks &&
+         ckpt->fingerprint == instance_fingerprint(inst);
+}
+
+/*
+ * Format:
+ *   line 0: rcrp-checkpoint version
+ *   line 1: n_stacks n_tiers n_blocks fingerprint
+ *   line 2: init_ub best_lb best_ub
+ *   line 3: time_used time_to_best_lb time_to_best_ub
+ *   line 4: n_nodes n_probe
+ *   line 5: p s d of each move of the best solution
+ *   line 6: n_paths rules
+ *   line 7...: depth dst[0] next[0] ... dst[depth - 1] next[depth - 1]
+ */
+bool write_checkpoint(char *output, checkpoint_t *ckpt) {
+  FILE *fp = fopen(output, "w");
+  if (fp == NULL) {
+    return false;
+  }
+
+  fprintf(fp, "rcrp-checkpoint %d\n", CHECKPOINT_VERSION);
+  fprintf(fp, "%d %d %d %016" PRIx64 "\n", ckpt->n_stacks, ckpt->n_tiers,
+          ckpt->n_blocks, ckpt->fingerprint);
+  fprintf(fp, "%d %d %d\n", ckpt->init_ub, ckpt->best_lb, ckpt->best_ub);
+  fprintf(fp, "%.6f %.6f %.6f\n", ckpt->time_used, ckpt->time_to_best_lb,
+          ckpt->time_to_best_ub);
+  fprintf(fp, "%ld %ld\n", ckpt->n_nodes, ckpt->n_probe);
+  for (int i = 0; i < ckpt->best_ub; i++) {
+    fprintf(fp, "%s%d %d %d", i == 0 ? "" : " ", ckpt->best_sol[i].p,
+            ckpt->best_sol[i].s, ckpt->best_sol[i].d);
+  }
+  fprintf(fp, "\n%d %u\n", ckpt->n_paths, ckpt->rules);
+  for (int k = 0; k < ckpt->n_paths; k++) {
+    resume_path_t *path = &ckpt->paths[k];
+    fprintf(fp, "%d", path->depth);
+    for (int l = 0; l < path->depth; l++) {
+      fprintf(fp, " %d %d", path->dst[l], path->next[l]);
+    }
+    fprintf(fp, "\n");
+  }
+
+  bool ok = !ferror(fp);
+  return fclose(fp) == 0 && ok;
+}
+
+checkpoint_t *read_checkpoint(char *input) {
+  FILE *fp = fopen(input, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  int version;
+  instance_t inst;
+  uint64_t fingerprint;
+  int init_ub, best_lb, best_ub;
+  if (fscanf(fp, "rcrp-checkpoint %d", &version) != 1 ||
+      version != CHECKPOINT_VERSION ||
+      fscanf(fp, "%d %d %d %" SCNx64, &inst.n_stacks, &inst.n_tiers,
+             &inst.n_blocks, &fingerprint) != 4 ||
+      fscanf(fp, "%d %d %d", &init_ub, &best_lb, &best_ub) != 3 ||
+      best_ub < 0) {
+    fclose(fp);
+    return NULL;
+  }
+
+  checkpoint_t *ckpt = malloc(sizeof(checkpoint_t));
+  ckpt->n_stacks = inst.n_stacks;
+  ckpt->n_tiers = inst.n_tiers;
+  ckpt->n_blocks = inst.n_blocks;
+  ckpt->fingerprint = fingerprint;
+  ckpt->init_ub = init_ub;
+  ckpt->best_lb = best_lb;
+  ckpt->best_ub = best_ub;
+  ckpt->best_sol = malloc(sizeof(move_t) * (best_ub > 0 ? best_ub : 1));
+  ckpt->n_paths = 0;
+  ckpt->paths = NULL;
+
+  int n_paths;
+  bool ok = fscanf(fp, "%lf %lf %lf", &ckpt->time_used,
+                   &ckpt->time_to_best_lb, &ckpt->time_to_best_ub) == 3 &&
+            fscanf(fp, "%ld %ld", &ckpt->n_nodes, &ckpt->n_probe) == 2;
+  for (int i = 0; ok && i < best_ub; i++) {
+    ok = fscanf(fp, "%d %d %d", &ckpt->best_sol[i].p, &ckpt->best_sol[i].s,
+                &ckpt->best_sol[i].d) == 3;
+  }
+  ok = ok && fscanf(fp, "%d %u", &n_paths, &ckpt->rules) == 2 &&
+       n_paths >= 0;
+  for (int k = 0; ok && k < n_paths; k++) {
+    int depth;
+    ok = fscanf(fp, "%d", &depth) == 1 && depth >= 0 && depth <= best_ub;
+    if (!ok) {
+      break;
+    }
+    int *dst = malloc(sizeof(int) * (depth > 0 ? depth : 1));
+    int *next = malloc(sizeof(int) * (depth > 0 ? depth : 1));
+    for (int l = 0; ok && l < depth; l++) {
+      ok = fscanf(fp, "%d %d", &dst[l], &next[l]) == 2;
+    }
+    if (ok) {
+      add_resume_path(ckpt, depth, dst, next);
+    }
+    free(dst);
+    free(next);
+  }
+  fclose(fp);
+
+  if (!ok) {
+    free_checkpoint(ckpt);
+    return NULL;
+  }
+  return ckpt;
+}
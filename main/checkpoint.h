@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "instance.h"
+#include "move.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct {
+  int depth; // level of the interrupted node
+  int *dst;  // dst[l]: destination of the move at level l of the path
+  int *next; // next[l]: first unexplored sibling at level l, -1 if none
+} resume_path_t;
+
+/*
+ * Progress of an interrupted run, i.e., the bounds, the incumbent and the
+ * counters, and the paths to the nodes being searched in the iteration of
+ * best_lb. Every sibling before next[l] at level l of a path has been
+ * searched, or is on another path, where siblings are indexed among the
+ * branches left by the dominance rules. The instance is identified by its
+ * dimensions and a fingerprint of its priorities.
+ */
+typedef struct {
+  int n_stacks;            // number of stacks of the instance
+  int n_tiers;             // number of tiers of the instance
+  int n_blocks;            // number of blocks of the instance
+  uint64_t fingerprint;    // fingerprint of the instance
+  int init_ub;             // initial upper bound
+  int best_lb;             // best lower bound, i.e., the interrupted iteration
+  int best_ub;             // best upper bound
+  move_t *best_sol;        // best solution with original priorities
+  double time_used;        // total time used in seconds
+  double time_to_best_lb;  // time to the best lower bound
+  double time_to_best_ub;  // time to the best upper bound
+  long n_nodes;            // number of nodes explored
+  long n_probe;            // number of nodes probed
+  unsigned rules;          // dominance rules the paths are searched with
+  int n_paths;             // number of paths
+  resume_path_t *paths;    // paths[k]: k-th path
+} checkpoint_t;
+
+/**
+ * Fingerprint of an instance, i.e., a hash of its dimensions and priorities
+ *
+ * @param inst the instance
+ * @return fingerprint
+ */
+uint64_t instance_fingerprint(instance_t *inst);
+
+/**
+ * Create a checkpoint without paths
+ *
+ * @param inst the interrupted instance
+ * @param best_ub best upper bound
+ * @param best_sol best solution with original priorities
+ * @return created checkpoint
+ */
+checkpoint_t *new_checkpoint(instance_t *inst, int best_ub, move_t *best_sol);
+
+/**
+ * Append a path to a checkpoint
+ *
+ * @param ckpt the checkpoint
+ * @param depth level of the interrupted node
+ * @param dst destinations of the moves on the path
+ * @param next first unexplored sibling at each level, -1 if none
+ */
+void add_resume_path(checkpoint_t *ckpt, int depth, int *dst, int *next);
+
+/**
+ * Free the space of a checkpoint
+ *
+ * @param ckpt the checkpoint
+ */
+void free_checkpoint(checkpoint_t *ckpt);
+
+/**
+ * Check if a checkpoint is taken from an instance
+ *
+ * @param ckpt the checkpoint
+ * @param inst the instance
+ * @return true if the dimensions and the fingerprint match
+ */
+bool match_checkpoint(checkpoint_t *ckpt, instance_t *inst);
+
+/**
+ * Write a checkpoint as text
+ *
+ * @param output output file
+ * @param ckpt the checkpoint
+ * @return true if succeeded
+ */
+bool write_checkpoint(char *output, checkpoint_t *ckpt);
+
+/**
+ * Read a checkpoint written by write_checkpoint
+ *
+ * @param input input file
+ * @return checkpoint, or NULL if failed
+ */
+checkpoint_t *read_checkpoint(char *input);
+
+#endif
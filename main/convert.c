@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "report.h"
+#include "timer.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: main-convert -h\n");
+  fprintf(stdout, "usage: main-convert"
+                  " --input/-i input_file"
+                  " --output/-o archive_file\n");
+  fprintf(stdout, "usage: main-convert"
+                  " --extract/-x archive_file"
+                  " --output/-o output_file\n");
+  fprintf(stdout, "\t--input/-i: text file of concatenated instances, which"
+                  " can be repeated\n");
+  fprintf(stdout, "\t--output/-o: binary archive to create, or text file to"
+                  " extract to (stdout by default)\n");
+  fprintf(stdout, "\t--extract/-x: binary archive to write back as text, with"
+                  " stored reports as comments\n");
+  fflush(stdout);
+}
+
+static bool convert(char **inputs, int n_inputs, const char *output) {
+  double start_time = get_wall_time();
+  archive_t *archive = create_archive(output);
+  if (archive == NULL) {
+    return false;
+  }
+  bool ok = true;
+  for (int i = 0; ok && i < n_inputs; i++) {
+    instance_reader_t *reader = open_instances(inputs[i]);
+    if (reader == NULL) {
+      fprintf(stderr, "Failed to read file: %s\n", inputs[i]);
+      ok = false;
+      break;
+    }
+    instance_t *inst;
+    while ((ok = next_instance(reader, &inst)) && inst != NULL) {
+      ok = append_instance(archive, inst);
+      free_instance(inst);
+      if (!ok) {
+        fprintf(stderr, "Failed to write file: %s\n", output);
+        break;
+      }
+    }
+    close_instances(reader);
+  }
+  long n_instances = archive->n_instances;
+  uint64_t size = archive->end;
+  if (!close_archive(archive)) {
+    fprintf(stderr, "Failed to write index of archive: %s\n", output);
+    ok = false;
+  }
+  fprintf(stderr, "instances = %ld / size = %.1f MB / time = %.3f\n",
+          n_instances, size / 1048576.0, get_wall_time() - start_time);
+  return ok;
+}
+
+static bool extract(const char *input, FILE *fp) {
+  archive_t *archive = open_archive(input, false);
+  if (archive == NULL) {
+    return false;
+  }
+  bool ok = true;
+  for (long k = 0; k < archive->n_instances; k++) {
+    instance_t *inst = load_instance(archive, k);
+    if (inst == NULL) {
+      fprintf(stderr, "Failed to read instance %ld of archive: %s\n", k,
+              input);
+      ok = false;
+      break;
+    }
+    report_t *report = load_report(archive, k);
+    if (report != NULL) {
+      fprintf(fp, "# best_lb = %d / best_ub = %d / time = %.3f / nodes = %ld\n",
+              report->best_lb, report->best_ub, report->time_used,
+              report->n_nodes);
+      fprintf(fp, "# ");
+      print_moves(fp, report->best_sol, report->best_ub);
+      free_report(report);
+    }
+    write_instance(fp, inst);
+    free_instance(inst);
+  }
+  close_archive(archive);
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hi:o:x:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"input", required_argument, NULL, 'i'},
+                             {"output", required_argument, NULL, 'o'},
+                             {"extract", required_argument, NULL, 'x'},
+                             {NULL, 0, NULL, 0}};
+
+  char **inputs = malloc(sizeof(char *) * argc);
+  int n_inputs = 0;
+  char *output = NULL;
+  char *archive = NULL;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'i':
+      inputs[n_inputs++] = optarg;
+      break;
+    case 'o':
+      output = optarg;
+      break;
+    case 'x':
+      archive = optarg;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+
+  bool ok;
+  if (archive != NULL) {
+    FILE *fp = output == NULL ? stdout : fopen(output, "w");
+    if (fp == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", output);
+      return EXIT_FAILURE;
+    }
+    ok = extract(archive, fp);
+    if (fp != stdout) {
+      fclose(fp);
+    }
+  } else if (n_inputs > 0 && output != NULL) {
+    ok = convert(inputs, n_inputs, output);
+  } else {
+    fprintf(stderr, "No input file or archive is given\n");
+    ok = false;
+  }
+  free(inputs);
+
+  return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "generator.h"
+#include <getopt.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void usage(void) {
+  fprintf(stdout, "usage: gen-instances -h\n");
+  fprintf(stdout, "usage: gen-instances"
+                  " --class/-c class"
+                  " --stacks/-S n_stacks"
+                  " --tiers/-T n_tiers"
+                  " --blocks/-b n_blocks"
+                  " --fill/-f fill_ratio"
+                  " --distribution/-d distribution"
+                  " --pattern/-p pattern"
+                  " --disorder/-x disorder"
+                  " --seed/-s seed"
+                  " --count/-n n_instances"
+                  " --output/-o output_directory\n");
+  fprintf(stdout, "\t--class/-c: class name, e.g., cv-5-8 or"
+                  " bf-20-8-120-sorted, instead of the options below\n");
+  fprintf(stdout, "\t--stacks/-S: number of stacks\n");
+  fprintf(stdout, "\t--tiers/-T: number of tiers\n");
+  fprintf(stdout, "\t--blocks/-b: number of blocks\n");
+  fprintf(stdout, "\t--fill/-f: number of blocks as a ratio of the slots\n");
+  fprintf(stdout, "\t--distribution/-d: fill distribution (level or random)\n");
+  fprintf(stdout, "\t--pattern/-p: priority pattern (random, sorted or"
+                  " adversarial)\n");
+  fprintf(stdout, "\t--disorder/-x: probability of displacing a block of a"
+                  " sorted instance, which is appended to the class name\n");
+  fprintf(stdout, "\t--seed/-s: random seed of the first instance\n");
+  fprintf(stdout, "\t--count/-n: number of instances with consecutive seeds\n");
+  fprintf(stdout, "\t--output/-o: directory of the instance files named"
+                  " class-seed.txt (stdout by default)\n");
+  fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hc:S:T:b:f:d:p:x:s:n:o:";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"class", required_argument, NULL, 'c'},
+                             {"stacks", required_argument, NULL, 'S'},
+                             {"tiers", required_argument, NULL, 'T'},
+                             {"blocks", required_argument, NULL, 'b'},
+                             {"fill", required_argument, NULL, 'f'},
+                             {"distribution", required_argument, NULL, 'd'},
+                             {"pattern", required_argument, NULL, 'p'},
+                             {"disorder", required_argument, NULL, 'x'},
+                             {"seed", required_argument, NULL, 's'},
+                             {"count", required_argument, NULL, 'n'},
+                             {"output", required_argument, NULL, 'o'},
+                             {NULL, 0, NULL, 0}};
+
+  char *class_name = NULL;
+  instance_class_t cls = {NULL, FAMILY_BF, 0, 0, 0, PATTERN_RANDOM, 0.25};
+  double fill = 0;
+  double disorder = -1;
+  uint64_t seed = 1;
+  int n_instances = 1;
+  char *output_dir = NULL;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'c':
+      class_name = optarg;
+      break;
+    case 'S':
+      cls.n_stacks = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'T':
+      cls.n_tiers = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'b':
+      cls.n_blocks = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'f':
+      fill = strtod(optarg, NULL);
+      break;
+    case 'd':
+      if (strcmp(optarg, "level") == 0) {
+        cls.family = FAMILY_CV;
+      } else if (strcmp(optarg, "random") == 0) {
+        cls.family = FAMILY_BF;
+      } else {
+        fprintf(stderr, "Unknown distribution: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'p':
+      if (strcmp(optarg, "random") == 0) {
+        cls.pattern = PATTERN_RANDOM;
+      } else if (strcmp(optarg, "sorted") == 0) {
+        cls.pattern = PATTERN_SORTED;
+      } else if (strcmp(optarg, "adversarial") == 0) {
+        cls.pattern = PATTERN_ADVERSARIAL;
+      } else {
+        fprintf(stderr, "Unknown pattern: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'x':
+      disorder = strtod(optarg, NULL);
+      if (disorder < 0 || disorder > 1) {
+        fprintf(stderr, "Invalid disorder: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 's':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    case 'n':
+      n_instances = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'o':
+      output_dir = optarg;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /*
+   * The class is named after its options, so that the same class name and
+   * seed give the same instance as main-bench
+   */
+  char name[64];
+  if (class_name != NULL) {
+    if (disorder >= 0) {
+      fprintf(stderr, "Disorder of a class is part of its name, e.g., "
+                      "bf-20-8-120-sorted0.4\n");
+      return EXIT_FAILURE;
+    }
+    if (!parse_class(class_name, &cls)) {
+      fprintf(stderr, "Unknown or infeasible class: %s\n", class_name);
+      return EXIT_FAILURE;
+    }
+  } else {
+    if (fill > 0) {
+      cls.n_blocks = (int)(fill * cls.n_stacks * cls.n_tiers + 0.5);
+    }
+    if (disorder >= 0 && cls.pattern != PATTERN_SORTED) {
+      fprintf(stderr, "Disorder only applies to sorted instances\n");
+      return EXIT_FAILURE;
+    }
+    const char *patterns[] = {"", "-sorted", "-adversarial"};
+    int len = snprintf(name, sizeof(name), "%s-%d-%d-%d%s",
+                       cls.family == FAMILY_CV ? "cv" : "bf", cls.n_stacks,
+                       cls.n_tiers, cls.n_blocks, patterns[cls.pattern]);
+    if (disorder >= 0) {
+      snprintf(name + len, sizeof(name) - len, "%g", disorder);
+    }
+    if (!parse_class(name, &cls)) {
+      fprintf(stderr, "Infeasible class: %s\n", name);
+      return EXIT_FAILURE;
+    }
+  }
+  if (output_dir == NULL && n_instances > 1) {
+    fprintf(stderr, "Multiple instances need an output directory\n");
+    return EXIT_FAILURE;
+  }
+
+  for (int i = 0; i < n_instances; i++) {
+    instance_t *inst = generate_instance(&cls, seed + i);
+    FILE *fp = stdout;
+    if (output_dir != NULL) {
+      char *file = malloc(strlen(output_dir) + strlen(cls.name) + 32);
+      sprintf(file, "%s/%s-%llu.txt", output_dir, cls.name,
+              (unsigned long long)(seed + i));
+      fp = fopen(file, "w");
+      if (fp == NULL) {
+        fprintf(stderr, "Failed to open file: %s\n", file);
+        free(file);
+        free_instance(inst);
+        return EXIT_FAILURE;
+      }
+      free(file);
+    }
+    write_instance(fp, inst);
+    if (fp != stdout) {
+      fclose(fp);
+    }
+    free_instance(inst);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "generator.h"
+#include "state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CV(h, w)                                                               \
+  {"cv-" #h "-" #w, FAMILY_CV, w, h + 2, h * w, PATTERN_RANDOM, 0}
+#define BF(s, t, n)                                                            \
+  {"bf-" #s "-" #t "-" #n, FAMILY_BF, s, t, n, PATTERN_RANDOM, 0}
+
+const instance_class_t standard_classes[] = {
+    CV(5, 6),      CV(5, 8),      CV(5, 10),     CV(6, 6),
+    CV(6, 8),      CV(7, 7),      BF(6, 5, 26),  BF(8, 5, 30),
+    BF(10, 6, 40), BF(10, 6, 50), BF(10, 7, 55),
+};
+const int n_standard_classes =
+    sizeof(standard_classes) / sizeof(instance_class_t);
+
+bool parse_class(const char *name, instance_class_t *cls) {
+  int a, b, c, len = -1;
+  memset(cls, 0, sizeof(instance_class_t));
+  cls->name = name;
+  if (sscanf(name, "cv-%d-%d-%d%n", &a, &b, &c, &len) == 3) {
+    cls->family = FAMILY_CV;
+    cls->n_stacks = a;
+    cls->n_tiers = b;
+    cls->n_blocks = c;
+  } else if (sscanf(name, "cv-%d-%d%n", &a, &b, &len) == 2) {
+    cls->family = FAMILY_CV;
+    cls->n_stacks = b;
+    cls->n_tiers = a + 2;
+    cls->n_blocks = a * b;
+  } else if (sscanf(name, "bf-%d-%d-%d%n", &a, &b, &c, &len) == 3) {
+    cls->family = FAMILY_BF;
+    cls->n_stacks = a;
+    cls->n_tiers = b;
+    cls->n_blocks = c;
+  } else {
+    return false;
+  }
+
+  if (strncmp(name + len, "-sorted", 7) == 0) {
+    const char *disorder = name + len + 7;
+    char *end;
+    cls->pattern = PATTERN_SORTED;
+    cls->disorder = *disorder == '\0' ? 0.25 : strtod(disorder, &end);
+    if (*disorder != '\0' &&
+        (end == disorder || *end != '\0' || cls->disorder < 0 ||
+         cls->disorder > 1)) {
+      return false;
+    }
+  } else if (strcmp(name + len, "-adversarial") == 0) {
+    cls->pattern = PATTERN_ADVERSARIAL;
+  } else if (name[len] != '\0') {
+    return false;
+  }
+  return is_feasible_class(cls);
+}
+
+bool is_feasible_class(const instance_class_t *cls) {
+  if (cls->n_stacks < 2 || cls->n_tiers < 1 || cls->n_blocks < 1) {
+    return false;
+  }
+  if (cls->family == FAMILY_CV &&
+      (cls->n_blocks + cls->n_stacks - 1) / cls->n_stacks > cls->n_tiers) {
+    return false;
+  }
+  return cls->n_blocks <= cls->n_stacks * cls->n_tiers - (cls->n_tiers - 1);
+}
+
+static uint64_t next_random(uint64_t *seed) {
+  *seed += 0x9e3779b97f4a7c15ULL;
+  return mix_hash(*seed);
+}
+
+/*
+ * Uniform integer in [0, n) without modulo bias
+ */
+static int random_below(uint64_t *seed, int n) {
+  uint64_t limit = UINT64_MAX - UINT64_MAX % (uint64_t)n;
+  uint64_t x;
+  do {
+    x = next_random(seed);
+  } while (x >= limit);
+  return (int)(x % (uint64_t)n);
+}
+
+instance_t *generate_instance(const instance_class_t *cls, uint64_t seed) {
+  for (const char *c = cls->name; *c != '\0'; c++) {
+    seed = mix_hash(seed ^ (uint8_t)*c);
+  }
+  instance_t *inst = malloc_instance(cls->n_stacks, cls->n_tiers);
+  inst->n_blocks = cls->n_blocks;
+  inst->max_prio = cls->n_blocks;
+
+  /*
+   * Priorities in the order of stacking, where later blocks are placed higher
+   */
+  int *perm = malloc(sizeof(int) * cls->n_blocks);
+  for (int i = 0; i < cls->n_blocks; i++) {
+    perm[i] = cls->pattern == PATTERN_SORTED ? cls->n_blocks - i : i + 1;
+  }
+  if (cls->pattern == PATTERN_RANDOM) {
+    /*
+     * Random permutation by Fisher-Yates shuffle
+     */
+    for (int i = cls->n_blocks - 1; i > 0; i--) {
+      int j = random_below(&seed, i + 1);
+      int tmp = perm[i];
+      perm[i] = perm[j];
+      perm[j] = tmp;
+    }
+  } else if (cls->pattern == PATTERN_SORTED) {
+    /*
+     * Displace each block with probability disorder
+     */
+    for (int i = 0; i < cls->n_blocks; i++) {
+      if ((next_random(&seed) >> 11) * 0x1p-53 < cls->disorder) {
+        int j = random_below(&seed, cls->n_blocks);
+        int tmp = perm[i];
+        perm[i] = perm[j];
+        perm[j] = tmp;
+      }
+    }
+  }
+
+  /*
+   * Stack the blocks from the ground up
+   */
+  memset(inst->h, 0, sizeof(int) * cls->n_stacks);
+  int *open = malloc(sizeof(int) * cls->n_stacks);
+  int n_open = cls->n_stacks;
+  for (int s = 0; s < cls->n_stacks; s++) {
+    open[s] = s;
+  }
+  for (int i = 0; i < cls->n_blocks; i++) {
+    int s;
+    if (cls->family == FAMILY_CV) {
+      s = i % cls->n_stacks;
+    } else {
+      int k = random_below(&seed, n_open);
+      s = open[k];
+      if (inst->h[s] + 1 == cls->n_tiers) {
+        open[k] = open[--n_open];
+      }
+    }
+    inst->p[s][++inst->h[s]] = perm[i];
+  }
+
+  free(open);
+  free(perm);
+  return inst;
+}
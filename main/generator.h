@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "instance.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+  FAMILY_CV, // stacks filled level by level, Caserta & Voss style
+  FAMILY_BF  // blocks dropped onto random non-full stacks, Zhu et al. style
+} family_t;
+
+typedef enum {
+  PATTERN_RANDOM,     // random permutation
+  PATTERN_SORTED,     // well-placed stacks, partially shuffled
+  PATTERN_ADVERSARIAL // every stack in reverse order of retrieval
+} pattern_t;
+
+typedef struct {
+  const char *name;  // class name
+  family_t family;   // fill distribution
+  int n_stacks;      // number of stacks
+  int n_tiers;       // number of tiers
+  int n_blocks;      // number of blocks
+  pattern_t pattern; // priority pattern
+  double disorder;   // probability of displacing a block, if sorted
+} instance_class_t;
+
+/*
+ * Standard classes, where each family is ordered from the easiest to the
+ * hardest. CV classes are named cv-height-stacks with two spare tiers, and BF
+ * classes are named bf-stacks-tiers-blocks.
+ */
+extern const instance_class_t standard_classes[];
+extern const int n_standard_classes;
+
+/**
+ * Parse a class name of the form cv-height-stacks, cv-stacks-tiers-blocks or
+ * bf-stacks-tiers-blocks, optionally followed by -sorted or -adversarial,
+ * where -sorted may end with the probability of displacing a block, such as
+ * -sorted0.4, and displaces a quarter of the blocks otherwise
+ *
+ * @param name class name, which is referenced by the class
+ * @param cls the class to be set
+ * @return true if the name is well formed and the instance is feasible
+ */
+bool parse_class(const char *name, instance_class_t *cls);
+
+/**
+ * Check if the instances of a class fit into the bay and leave enough free
+ * slots to relocate any block
+ *
+ * @param cls the class
+ * @return true if feasible
+ */
+bool is_feasible_class(const instance_class_t *cls);
+
+/**
+ * Generate a random instance of a class, where the priorities are a
+ * permutation of 1, ..., n_blocks following the class pattern. The seed is
+ * mixed with the class name, so the same class and seed always give the same
+ * instance on every platform.
+ *
+ * @param cls the class
+ * @param seed random seed
+ * @return created instance
+ */
+instance_t *generate_instance(const instance_class_t *cls, uint64_t seed);
+
+#endif
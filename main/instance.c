@@ -16,18 +16,37 @@
  */
 
 #include "instance.h"
+#include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 instance_t *malloc_instance(int n_stacks, int n_tiers) {
+  size_t n_cells = (size_t)n_stacks * ((size_t)n_tiers + 1);
+  if (n_stacks < 1 || n_tiers < 1 || n_cells > SIZE_MAX / sizeof(int)) {
+    return NULL;
+  }
   instance_t *inst = malloc(sizeof(instance_t));
+  if (inst == NULL) {
+    return NULL;
+  }
   inst->n_stacks = n_stacks;
   inst->n_tiers = n_tiers;
-  inst->h = malloc(sizeof(int) * n_stacks);
-  inst->p = malloc(sizeof(int *) * n_stacks);
-  inst->p[0] = malloc(sizeof(int) * n_stacks * (n_tiers + 1));
-  for (int s = 1; s < n_stacks; s++) {
-    inst->p[s] = inst->p[0] + s * (n_tiers + 1);
+  inst->h = malloc(sizeof(int) * (size_t)n_stacks);
+  inst->p = malloc(sizeof(int *) * (size_t)n_stacks);
+  int *cells = malloc(sizeof(int) * n_cells);
+  if (inst->h == NULL || inst->p == NULL || cells == NULL) {
+    free(inst->h);
+    free(inst->p);
+    free(cells);
+    free(inst);
+    return NULL;
+  }
+  for (int s = 0; s < n_stacks; s++) {
+    inst->p[s] = cells + (size_t)s * ((size_t)n_tiers + 1);
   }
   return inst;
 }
@@ -39,90 +58,380 @@ void free_instance(instance_t *inst) {
   free(inst);
 }
 
-static char *parse_int(char *iter, int *num) {
-  char *next;
-  *num = (int)strtol(iter, &next, 10);
-  return iter == next ? NULL : next;
+instance_reader_t *open_instances_buffer(const char *input, char *data,
+                                         size_t size) {
+  instance_reader_t *reader = malloc(sizeof(instance_reader_t));
+  reader->input = input;
+  reader->data = data;
+  reader->mapped = false;
+  reader->size = size;
+  reader->pos = 0;
+  reader->line = 1;
+  reader->n_instances = 0;
+  return reader;
 }
 
-instance_t *read_instance(char *input) {
-  FILE *fp = fopen(input, "r");
-  if (fp == NULL) {
+instance_reader_t *open_instances(const char *input) {
+  int fd = open(input, O_RDONLY);
+  if (fd < 0) {
     fprintf(stderr, "Failed to open file: %s\n", input);
     return NULL;
   }
+  struct stat sb;
+  if (fstat(fd, &sb) != 0) {
+    fprintf(stderr, "Failed to stat file: %s\n", input);
+    close(fd);
+    return NULL;
+  }
+
+  instance_reader_t *reader =
+      open_instances_buffer(input, NULL, (size_t)sb.st_size);
+  if (reader->size > 0) {
+    reader->mapped = true;
+    reader->data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (reader->data == MAP_FAILED) {
+      fprintf(stderr, "Failed to map file: %s\n", input);
+      close(fd);
+      free(reader);
+      return NULL;
+    }
+    madvise(reader->data, reader->size, MADV_SEQUENTIAL);
+  }
+  close(fd);
+  return reader;
+}
+
+void close_instances(instance_reader_t *reader) {
+  if (reader->mapped) {
+    munmap(reader->data, reader->size);
+  }
+  free(reader);
+}
+
+/*
+ * Skip blanks, line breaks and comments up to the next token, and return false
+ * at the end of the file
+ */
+static bool skip_space(instance_reader_t *reader) {
+  const char *data = reader->data;
+  size_t pos = reader->pos;
+  while (pos < reader->size) {
+    char c = data[pos];
+    if (c == '\n') {
+      reader->line++;
+    } else if (c == '#') {
+      while (pos + 1 < reader->size && data[pos + 1] != '\n') {
+        pos++;
+      }
+    } else if (c != ' ' && c != '\t' && c != '\r') {
+      break;
+    }
+    pos++;
+  }
+  reader->pos = pos;
+  return pos < reader->size;
+}
 
-  char buf[BUFSIZ];
-  int line = 0;
-  char *iter;
+static bool scan_int(instance_reader_t *reader, int *num) {
+  if (!skip_space(reader)) {
+    return false;
+  }
+  const char *data = reader->data;
+  size_t pos = reader->pos;
+  bool negative = pos < reader->size && data[pos] == '-';
+  pos += negative;
+  size_t first = pos;
+  long x = 0;
+  while (pos < reader->size && data[pos] >= '0' && data[pos] <= '9' &&
+         x <= INT_MAX) {
+    x = x * 10 + (data[pos++] - '0');
+  }
+  if (pos == first || x > INT_MAX) {
+    return false;
+  }
+  reader->pos = pos;
+  *num = (int)(negative ? -x : x);
+  return true;
+}
 
-  do {
-    line++;
-    iter = fgets(buf, BUFSIZ, fp) + strspn(buf, " \t");
-  } while (*iter == '#' || *iter == '\0');
+bool next_instance(instance_reader_t *reader, instance_t **inst) {
+  *inst = NULL;
+  if (!skip_space(reader)) {
+    return true;
+  }
 
   int n_stacks;
-  iter = parse_int(iter, &n_stacks);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_stacks in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+  if (!scan_int(reader, &n_stacks) || n_stacks < 1) {
+    fprintf(stderr, "Failed to read n_stacks in line %d of %s\n", reader->line,
+            reader->input);
+    return false;
   }
   int n_tiers;
-  iter = parse_int(iter, &n_tiers);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_tiers in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+  if (!scan_int(reader, &n_tiers) || n_tiers < 1) {
+    fprintf(stderr, "Failed to read n_tiers in line %d of %s\n", reader->line,
+            reader->input);
+    return false;
   }
   int n_blocks;
-  iter = parse_int(iter, &n_blocks);
-  if (iter == NULL) {
-    fprintf(stderr, "Failed to read n_blocks in line %d: %s\n", line, buf);
-    fclose(fp);
-    return NULL;
+  if (!scan_int(reader, &n_blocks)) {
+    fprintf(stderr, "Failed to read n_blocks in line %d of %s\n", reader->line,
+            reader->input);
+    return false;
   }
 
-  instance_t *inst = malloc_instance(n_stacks, n_tiers);
-  inst->n_blocks = n_blocks;
-  inst->max_prio = 0;
+  instance_t *dst = malloc_instance(n_stacks, n_tiers);
+  if (dst == NULL) {
+    fprintf(stderr, "Failed to allocate instance in line %d of %s\n",
+            reader->line, reader->input);
+    return false;
+  }
+  dst->n_blocks = n_blocks;
+  dst->max_prio = 0;
 
   for (int s = 0; s < n_stacks; s++) {
-    do {
-      line++;
-      iter = fgets(buf, BUFSIZ, fp) + strspn(buf, " \t");
-    } while (*iter == '#' || *iter == '\0');
-
-    iter = parse_int(iter, &inst->h[s]);
-    if (iter == NULL) {
-      fprintf(stderr, "Failed to read h[%d] in line %d: %s\n", s + 1, line,
-              buf);
-      fclose(fp);
-      free_instance(inst);
-      return NULL;
+    if (!scan_int(reader, &dst->h[s]) || dst->h[s] < 0 ||
+        dst->h[s] > n_tiers) {
+      fprintf(stderr, "Failed to read h[%d] in line %d of %s\n", s + 1,
+              reader->line, reader->input);
+      free_instance(dst);
+      return false;
     }
 
-    for (int t = 1; t <= inst->h[s]; t++) {
-      iter = parse_int(iter, &inst->p[s][t]);
-      if (iter == NULL) {
-        fprintf(stderr, "Failed to read p[%d][%d] in line %d: %s\n", s + 1, t,
-                line, buf);
-        fclose(fp);
-        free_instance(inst);
-        return NULL;
+    for (int t = 1; t <= dst->h[s]; t++) {
+      if (!scan_int(reader, &dst->p[s][t])) {
+        fprintf(stderr, "Failed to read p[%d][%d] in line %d of %s\n", s + 1,
+                t, reader->line, reader->input);
+        free_instance(dst);
+        return false;
       }
 
-      if (inst->max_prio < inst->p[s][t]) {
-        inst->max_prio = inst->p[s][t];
+      if (dst->max_prio < dst->p[s][t]) {
+        dst->max_prio = dst->p[s][t];
       }
     }
   }
 
-  fclose(fp);
+  reader->n_instances++;
+  *inst = dst;
+  return true;
+}
 
+instance_t *read_instance(char *input) {
+  instance_reader_t *reader = open_instances(input);
+  if (reader == NULL) {
+    return NULL;
+  }
+  instance_t *inst;
+  if (next_instance(reader, &inst) && inst == NULL) {
+    fprintf(stderr, "No instance in file: %s\n", input);
+  }
+  close_instances(reader);
   return inst;
 }
 
+/*
+ * Binary archive
+ */
+#define ARCHIVE_MAGIC "RCRPARCH"
+#define ARCHIVE_VERSION 1
+#define ARCHIVE_BYTE_ORDER 0x01020304
+
+static bool write_header(archive_t *archive) {
+  uint32_t head[2] = {ARCHIVE_VERSION, ARCHIVE_BYTE_ORDER};
+  uint64_t tail[2] = {(uint64_t)archive->n_instances, archive->end};
+  return fseeko(archive->fp, 0, SEEK_SET) == 0 &&
+         fwrite(ARCHIVE_MAGIC, 1, 8, archive->fp) == 8 &&
+         fwrite(head, sizeof(uint32_t), 2, archive->fp) == 2 &&
+         fwrite(tail, sizeof(uint64_t), 2, archive->fp) == 2;
+}
+
+static archive_t *new_archive(FILE *fp, bool writable) {
+  archive_t *archive = malloc(sizeof(archive_t));
+  archive->fp = fp;
+  archive->writable = writable;
+  archive->dirty = false;
+  archive->n_instances = 0;
+  archive->end = 32;
+  archive->index = NULL;
+  return archive;
+}
+
+static void free_archive(archive_t *archive) {
+  fclose(archive->fp);
+  free(archive->index);
+  free(archive);
+}
+
+archive_t *create_archive(const char *output) {
+  FILE *fp = fopen(output, "w+b");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to create file: %s\n", output);
+    return NULL;
+  }
+  archive_t *archive = new_archive(fp, true);
+  archive->dirty = true;
+  if (!write_header(archive)) {
+    fprintf(stderr, "Failed to write file: %s\n", output);
+    free_archive(archive);
+    return NULL;
+  }
+  return archive;
+}
+
+archive_t *open_archive(const char *input, bool writable) {
+  FILE *fp = fopen(input, writable ? "r+b" : "rb");
+  if (fp == NULL) {
+    fprintf(stderr, "Failed to open file: %s\n", input);
+    return NULL;
+  }
+  archive_t *archive = new_archive(fp, writable);
+
+  char magic[8];
+  uint32_t head[2];
+  uint64_t tail[2];
+  if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, ARCHIVE_MAGIC, 8) != 0 ||
+      fread(head, sizeof(uint32_t), 2, fp) != 2 ||
+      head[0] != ARCHIVE_VERSION || head[1] != ARCHIVE_BYTE_ORDER ||
+      fread(tail, sizeof(uint64_t), 2, fp) != 2) {
+    fprintf(stderr, "Not an archive of version %d in this byte order: %s\n",
+            ARCHIVE_VERSION, input);
+    free_archive(archive);
+    return NULL;
+  }
+
+  archive->n_instances = (long)tail[0];
+  archive->end = tail[1];
+  archive->index = malloc(sizeof(uint64_t) * 2 * (archive->n_instances + 1));
+  if (fseeko(fp, (off_t)archive->end, SEEK_SET) != 0 ||
+      fread(archive->index, sizeof(uint64_t), 2 * archive->n_instances, fp) !=
+          (size_t)(2 * archive->n_instances)) {
+    fprintf(stderr, "Failed to read index of archive: %s\n", input);
+    free_archive(archive);
+    return NULL;
+  }
+  archive->end += sizeof(uint64_t) * 2 * archive->n_instances;
+  return archive;
+}
+
+bool close_archive(archive_t *archive) {
+  bool ok = true;
+  if (archive->dirty) {
+    /*
+     * The header is updated only once the new index is out, so that it keeps
+     * referencing the old index if the index cannot be written
+     */
+    ok = fseeko(archive->fp, (off_t)archive->end, SEEK_SET) == 0 &&
+         fwrite(archive->index, sizeof(uint64_t), 2 * archive->n_instances,
+                archive->fp) == (size_t)(2 * archive->n_instances) &&
+         fflush(archive->fp) == 0 && write_header(archive) &&
+         fflush(archive->fp) == 0;
+  }
+  free_archive(archive);
+  return ok;
+}
+
+bool append_instance(archive_t *archive, instance_t *inst) {
+  if (!archive->writable) {
+    return false;
+  }
+  int max_cell =
+      inst->max_prio > inst->n_tiers ? inst->max_prio : inst->n_tiers;
+  int cell_bytes = max_cell <= UINT8_MAX ? 1 : max_cell <= UINT16_MAX ? 2 : 4;
+  int n_cells = inst->n_stacks * (inst->n_tiers + 1);
+  int32_t head[4] = {inst->n_stacks, inst->n_tiers, inst->n_blocks,
+                     cell_bytes};
+  void *cells = calloc(n_cells, cell_bytes);
+  for (int s = 0; s < inst->n_stacks; s++) {
+    for (int t = 0; t <= inst->n_tiers; t++) {
+      int i = t == 0 ? s : inst->n_stacks * t + s;
+      int x = t == 0 ? inst->h[s] : t <= inst->h[s] ? inst->p[s][t] : 0;
+      if (cell_bytes == 1) {
+        ((uint8_t *)cells)[i] = (uint8_t)x;
+      } else if (cell_bytes == 2) {
+        ((uint16_t *)cells)[i] = (uint16_t)x;
+      } else {
+        ((int32_t *)cells)[i] = x;
+      }
+    }
+  }
+
+  bool ok = fseeko(archive->fp, (off_t)archive->end, SEEK_SET) == 0 &&
+            fwrite(head, sizeof(int32_t), 4, archive->fp) == 4 &&
+            fwrite(cells, cell_bytes, n_cells, archive->fp) ==
+                (size_t)n_cells;
+  free(cells);
+  if (!ok) {
+    return false;
+  }
+
+  long k = archive->n_instances++;
+  archive->index =
+      realloc(archive->index, sizeof(uint64_t) * 2 * archive->n_instances);
+  archive->index[2 * k] = archive->end;
+  archive->index[2 * k + 1] = 0;
+  archive->end += sizeof(int32_t) * 4 + (uint64_t)cell_bytes * n_cells;
+  archive->dirty = true;
+  return true;
+}
+
+instance_t *load_instance(archive_t *archive, long k) {
+  if (k < 0 || k >= archive->n_instances) {
+    return NULL;
+  }
+  int32_t head[4];
+  if (fseeko(archive->fp, (off_t)archive->index[2 * k], SEEK_SET) != 0 ||
+      fread(head, sizeof(int32_t), 4, archive->fp) != 4 || head[0] < 1 ||
+      head[1] < 1 || (head[3] != 1 && head[3] != 2 && head[3] != 4)) {
+    return NULL;
+  }
+
+  size_t n_cells = (size_t)head[0] * ((size_t)head[1] + 1);
+  void *cells = malloc((size_t)head[3] * n_cells);
+  if (cells == NULL) {
+    return NULL;
+  }
+  if (fread(cells, head[3], n_cells, archive->fp) != n_cells) {
+    free(cells);
+    return NULL;
+  }
+
+  instance_t *inst = malloc_instance(head[0], head[1]);
+  if (inst == NULL) {
+    free(cells);
+    return NULL;
+  }
+  inst->n_blocks = head[2];
+  inst->max_prio = 0;
+  for (size_t i = 0; i < n_cells; i++) {
+    int s = (int)(i % (size_t)head[0]);
+    int t = (int)(i / (size_t)head[0]);
+    int x = head[3] == 1   ? ((uint8_t *)cells)[i]
+            : head[3] == 2 ? ((uint16_t *)cells)[i]
+                           : ((int32_t *)cells)[i];
+    if (t == 0) {
+      inst->h[s] = x < 0 || x > head[1] ? 0 : x;
+    } else {
+      inst->p[s][t] = x;
+      if (t <= inst->h[s] && inst->max_prio < x) {
+        inst->max_prio = x;
+      }
+    }
+  }
+  free(cells);
+  return inst;
+}
+
+void write_instance(FILE *fp, instance_t *inst) {
+  fprintf(fp, "%d %d %d\n", inst->n_stacks, inst->n_tiers, inst->n_blocks);
+  for (int s = 0; s < inst->n_stacks; s++) {
+    fprintf(fp, "%d", inst->h[s]);
+    for (int t = 1; t <= inst->h[s]; t++) {
+      fprintf(fp, " %d", inst->p[s][t]);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
 void print_instance(FILE *fp, instance_t *inst) {
   for (int t = inst->n_tiers; t >= 1; t--) {
     for (int s = 0; s < inst->n_stacks; s++) {
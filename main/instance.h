@@ -18,6 +18,9 @@
 #ifndef INSTANCE_H
 #define INSTANCE_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 typedef struct {
@@ -29,12 +32,44 @@ typedef struct {
   int **p;      // priority matrix
 } instance_t;
 
+typedef struct {
+  const char *input; // input file name
+  char *data;        // mapped contents of the file
+  bool mapped;       // true if the data is mapped by the reader
+  size_t size;       // size of the file in bytes
+  size_t pos;        // position of the next byte
+  int line;          // line of the next byte, indexed from 1
+  long n_instances;  // number of instances read so far
+} instance_reader_t;
+
+/*
+ * Binary archive of instances and optionally their reports. It starts with a
+ * 32-byte header (magic RCRPARCH, version, byte order mark 0x01020304, number
+ * of instances, offset of the index) followed by the records and the index,
+ * i.e., the offsets of the k-th instance and of its report (0 if none) for
+ * each k. An instance record holds n_stacks, n_tiers, n_blocks and the cell
+ * width (1, 2 or 4 bytes) as 32-bit integers, followed by the heights and the
+ * priority matrix tier by tier as fixed-width cells. Records appended to an
+ * existing archive follow its index, which the header keeps referencing until
+ * the new index is written, so an interrupted run leaves the archive as it
+ * was opened.
+ */
+typedef struct {
+  FILE *fp;          // archive file
+  bool writable;     // true if records can be appended
+  bool dirty;        // true if the index has to be written back
+  long n_instances;  // number of instances
+  uint64_t end;      // end of the records, where the next record goes
+  uint64_t *index;   // index[2 * k], index[2 * k + 1]: offsets of instance k
+} archive_t;
+
 /**
  * Create space for an instance
  *
  * @param n_stacks number of stacks
  * @param n_tiers number of tiers
- * @return created instance
+ * @return created instance, or NULL if the dimensions are not positive or the
+ *         space cannot be allocated
  */
 instance_t *malloc_instance(int n_stacks, int n_tiers);
 
@@ -53,6 +88,93 @@ void free_instance(instance_t *inst);
  */
 instance_t *read_instance(char *input);
 
+/**
+ * Map a file of any number of concatenated instances into memory. Lines can
+ * be of any length, and lines starting with # are comments.
+ *
+ * @param input input file name
+ * @return created reader, or NULL if the file cannot be mapped
+ */
+instance_reader_t *open_instances(const char *input);
+
+/**
+ * Read instances from a buffer instead of a file
+ *
+ * @param input name of the buffer in error messages
+ * @param data the buffer, which must outlive the reader
+ * @param size size of the buffer in bytes
+ * @return created reader
+ */
+instance_reader_t *open_instances_buffer(const char *input, char *data,
+                                         size_t size);
+
+/**
+ * Read the next instance of a reader
+ *
+ * @param reader the reader
+ * @param inst pointer to the created instance, NULL at the end of the file
+ * @return false if the next instance is malformed
+ */
+bool next_instance(instance_reader_t *reader, instance_t **inst);
+
+/**
+ * Unmap the file if mapped and free the space of a reader
+ *
+ * @param reader the reader
+ */
+void close_instances(instance_reader_t *reader);
+
+/**
+ * Create an empty binary archive, overwriting any existing file
+ *
+ * @param output output file name
+ * @return created archive, or NULL if the file cannot be created
+ */
+archive_t *create_archive(const char *output);
+
+/**
+ * Open a binary archive
+ *
+ * @param input input file name
+ * @param writable true if instances or reports will be added
+ * @return opened archive, or NULL if the file is not a valid archive
+ */
+archive_t *open_archive(const char *input, bool writable);
+
+/**
+ * Write the index back if needed and close a binary archive
+ *
+ * @param archive the archive
+ * @return false if the index cannot be written
+ */
+bool close_archive(archive_t *archive);
+
+/**
+ * Append an instance to a binary archive
+ *
+ * @param archive the archive
+ * @param inst the instance
+ * @return false if the record cannot be written
+ */
+bool append_instance(archive_t *archive, instance_t *inst);
+
+/**
+ * Load the k-th instance of a binary archive without reading the others
+ *
+ * @param archive the archive
+ * @param k index of the instance, from 0
+ * @return created instance, or NULL if the record cannot be read
+ */
+instance_t *load_instance(archive_t *archive, long k);
+
+/**
+ * Write an instance in the input format
+ *
+ * @param fp output stream
+ * @param inst the instance
+ */
+void write_instance(FILE *fp, instance_t *inst);
+
 /**
  * Print an instance
  *
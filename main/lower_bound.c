@@ -16,6 +16,7 @@
  */
 
 #include "lower_bound.h"
+#include <stdlib.h>
 #include <string.h>
 
 /*
@@ -54,84 +55,279 @@ static int enumerate(int *priority, int next, int n_bad, int *quality, int len,
   return best;
 }
 
-static int compare_stacks(int s1, int s2, int *h, int **q) {
-  return q[s1][h[s1]] - q[s2][h[s2]];
+/*
+ * As enumerate, for distinct qualities less than 64 held as the bits of a
+ * word. The block of priority p is placed on the lowest set bit not less than
+ * p, and the qualities stay distinct since none lies between the two.
+ */
+static int enumerate_bits(int *priority, int next, int n_bad, uint64_t bits,
+                          int curr, int best) {
+  if (next == n_bad) {
+    return curr;
+  }
+
+  int p = priority[next];
+  uint64_t below = bits & ((UINT64_C(1) << p) - 1);
+  uint64_t above = bits ^ below;
+  if (above != 0) {
+    uint64_t placed = (bits ^ (above & -above)) | UINT64_C(1) << p;
+    best = enumerate_bits(priority, next + 1, n_bad, placed, curr, best);
+  }
+
+  if (below != 0 && curr + 1 < best) {
+    best = enumerate_bits(priority, next + 1, n_bad, bits, curr + 1, best);
+  }
+
+  return best;
 }
 
-static void adjust_right(int s, int i, int n_stacks, int *h, int *list,
-                         int **q) {
-  while (i < n_stacks - 1 && compare_stacks(s, list[i + 1], h, q) > 0) {
-    list[i] = list[i + 1];
-    i++;
+/*
+ * Additional relocations of the n_bad blocks at a step with the len qualities
+ * in ascending order. The qualities are held as the bits of a word if they
+ * fit, where equal qualities take the following bits. This is exact unless a
+ * priority falls on such a bit, in which case the array is enumerated instead.
+ */
+static int relocate_cost(int *priority, int n_bad, int *quality, int len) {
+  uint64_t bits = 0;
+  uint64_t spread = 0;
+  int last = -1;
+  for (int i = 0; i < len; i++) {
+    if (last < quality[i]) {
+      last = quality[i];
+    } else if (++last < 64) {
+      spread |= UINT64_C(1) << last;
+    }
+    if (last >= 64) {
+      return enumerate(priority, 0, n_bad, quality, len, 0, n_bad - 1);
+    }
+    bits |= UINT64_C(1) << last;
+  }
+  for (int i = 0; i < n_bad; i++) {
+    if (priority[i] >= 64 || ((spread >> priority[i]) & 1) != 0) {
+      return enumerate(priority, 0, n_bad, quality, len, 0, n_bad - 1);
+    }
   }
-  list[i] = s;
+  return enumerate_bits(priority, 0, n_bad, bits, 0, n_bad - 1);
 }
 
-int lb4(state_t *state, int max_k, int *h, int *list, int *quality,
-        int *priority) {
-  if (state->n_bad == 0 || max_k == 0) {
-    return state->n_bad;
+/*
+ * Generic kernel
+ */
+#define KERNEL(name) name
+#define KERNEL_STACKS n_stacks
+#define KERNEL_TIERS n_tiers
+#include "lower_bound_kernel.h"
+
+/*
+ * Kernels specialized for the shapes in KERNEL_SHAPES
+ */
+#define KERNEL(name) name##_6x4
+#define KERNEL_STACKS 6
+#define KERNEL_TIERS 4
+#include "lower_bound_kernel.h"
+
+#define KERNEL(name) name##_6x5
+#define KERNEL_STACKS 6
+#define KERNEL_TIERS 5
+#include "lower_bound_kernel.h"
+
+#define KERNEL(name) name##_8x5
+#define KERNEL_STACKS 8
+#define KERNEL_TIERS 5
+#include "lower_bound_kernel.h"
+
+#define KERNEL(name) name##_10x6
+#define KERNEL_STACKS 10
+#define KERNEL_TIERS 6
+#include "lower_bound_kernel.h"
+
+lb4_t find_lb4(int n_stacks, int n_tiers) {
+#define FIND_LB4(S, T)                                                         \
+  if (n_stacks == S && n_tiers == T) {                                         \
+    return lb4_##S##x##T;                                                      \
   }
+  KERNEL_SHAPES(FIND_LB4)
+#undef FIND_LB4
+  return lb4;
+}
+
+/*
+ * Incremental LB4
+ */
+
+trace_t *malloc_trace(int n_stacks, int n_tiers) {
+  trace_t *trace = malloc(sizeof(trace_t));
+  trace->n_stacks = n_stacks;
+  trace->n_tiers = n_tiers;
+  int n_steps = n_stacks * n_tiers; // each step removes at least one block
+  trace->h = malloc(sizeof(int) * n_stacks);
+  trace->list = malloc(sizeof(int) * n_stacks);
+  trace->step = malloc(sizeof(int) * n_stacks);
+  trace->q_max = malloc(sizeof(int) * n_steps);
+  trace->cost = malloc(sizeof(int) * n_steps);
+  trace->len = malloc(sizeof(int) * n_steps);
+  trace->quality = malloc(sizeof(int) * n_steps * n_stacks);
+  trace->n_prio = malloc(sizeof(int) * n_steps);
+  trace->prio = malloc(sizeof(int) * n_steps * (n_tiers + 1));
+  return trace;
+}
+
+void free_trace(trace_t *trace) {
+  free(trace->h);
+  free(trace->list);
+  free(trace->step);
+  free(trace->q_max);
+  free(trace->cost);
+  free(trace->len);
+  free(trace->quality);
+  free(trace->n_prio);
+  free(trace->prio);
+  free(trace);
+}
 
+static int step_cost(int *prio, int n_prio, int q_max, int *quality, int len,
+                     int *priority) {
+  int k = 0;
+  int n_bad = 0;
+  for (int i = 0; i < n_prio; i++) {
+    if (prio[i] > q_max) {
+      k++;
+    } else {
+      priority[n_bad++] = prio[i];
+    }
+  }
+  if (n_bad > 1) {
+    k += relocate_cost(priority, n_bad, quality, len);
+  }
+  return k;
+}
+
+static int trace_cost(trace_t *trace, int i, int *priority) {
+  if (trace->cost[i] < 0) {
+    trace->cost[i] = step_cost(
+        trace->prio + i * (trace->n_tiers + 1) + 1, trace->n_prio[i],
+        trace->q_max[i], trace->quality + i * trace->n_stacks, trace->len[i],
+        priority);
+  }
+  return trace->cost[i];
+}
+
+void lb4_trace(state_t *state, int k, trace_t *trace) {
   int n_stacks = state->n_stacks;
   int n_tiers = state->n_tiers;
-  int remain = state->n_bad;
-  int **p = state->p;
-  int **q = state->q;
-  int **b = state->b;
+  int *h = trace->h;
+  int *list = trace->list;
+  cell_t **q = state->q;
 
   memcpy(h, state->h, sizeof(int) * n_stacks);
   memcpy(list, state->list, sizeof(int) * n_stacks);
+  for (int s = 0; s < n_stacks; s++) {
+    trace->step[s] = -1;
+  }
 
-  int q_max;
   for (int i = n_stacks - 1;; i--) {
     int s = list[i];
     if (h[s] < n_tiers) {
-      q_max = q[s][h[s]];
+      trace->curr_q_max = q[s][h[s]];
       break;
     }
   }
 
-  int k = 0;
-  while (remain > 0) {
-    int s_min = list[0];
-    int bad_cnt = b[s_min][h[s_min]];
-
-    int n_bad = 0;
-    for (int t = h[s_min]; t > h[s_min] - bad_cnt; t--) {
-      if (p[s_min][t] > q_max) {
-        if (++k >= max_k) {
-          return state->n_bad + k;
-        }
-      } else {
-        priority[n_bad++] = p[s_min][t];
-      }
-    }
+  trace->state = state;
+  trace->k = k;
+  trace->cost_out = -1;
+  trace->n_steps = 0;
+  trace->remain = state->n_bad;
+}
 
-    if (n_bad > 1) {
-      int len = 0;
-      for (int i = 1; i < n_stacks; i++) {
-        int s = list[i];
-        if (h[s] < n_tiers) {
-          quality[len++] = q[s][h[s]];
-        }
-      }
+/*
+ * Simulate one more step of LB4, or return false if the simulation is over
+ */
+static bool extend_trace(trace_t *trace) {
+  if (trace->remain == 0) {
+    return false;
+  }
+
+  int n_stacks = trace->n_stacks;
+  int n_tiers = trace->n_tiers;
+  int *h = trace->h;
+  int *list = trace->list;
+  cell_t **p = trace->state->p;
+  cell_t **q = trace->state->q;
+  cell_t **b = trace->state->b;
+
+  int i = trace->n_steps++;
+  int s_min = list[0];
+  int bad_cnt = b[s_min][h[s_min]];
+
+  int *prio = trace->prio + i * (n_tiers + 1) + 1;
+  for (int j = 0; j < bad_cnt; j++) {
+    prio[j] = p[s_min][h[s_min] - j];
+  }
 
-      if ((k += enumerate(priority, 0, n_bad, quality, len, 0, n_bad - 1)) >=
-          max_k) {
-        return state->n_bad + k;
+  /*
+   * A child adds at most one block to a step, so the qualities matter only
+   * for steps with a badly-placed block
+   */
+  int *quality = trace->quality + i * n_stacks;
+  int len = 0;
+  if (bad_cnt > 0) {
+    for (int j = 1; j < n_stacks; j++) {
+      int s = list[j];
+      if (h[s] < n_tiers) {
+        quality[len++] = q[s][h[s]];
       }
     }
+  }
+
+  if (trace->step[s_min] < 0) {
+    trace->step[s_min] = i;
+  }
+  trace->q_max[i] = trace->curr_q_max;
+  trace->len[i] = len;
+  trace->n_prio[i] = bad_cnt;
+  trace->cost[i] = bad_cnt > 0 ? -1 : 0;
 
-    remain -= bad_cnt;
-    h[s_min] -= bad_cnt + 1;
+  trace->remain -= bad_cnt;
+  h[s_min] -= bad_cnt + 1;
 
-    adjust_right(s_min, 0, n_stacks, h, list, q);
+  adjust_right(s_min, h, list, q[0], n_stacks, n_tiers);
 
-    if (q_max < q[s_min][h[s_min]]) {
-      q_max = q[s_min][h[s_min]];
-    }
+  if (trace->curr_q_max < q[s_min][h[s_min]]) {
+    trace->curr_q_max = q[s_min][h[s_min]];
+  }
+  return true;
+}
+
+int lb4_child(trace_t *trace, int n_bad, int p, int d, int *priority) {
+  /*
+   * Only the steps processing the source and destination stacks differ: the
+   * former loses its topmost badly-placed block, and the latter gains one
+   */
+  while (trace->step[d] < 0 && extend_trace(trace)) {
+  }
+  int i = trace->step[d];
+  if (i < 0) {
+    return -1;
+  }
+
+  if (trace->cost_out < 0) {
+    trace->cost_out =
+        step_cost(trace->prio + 2, trace->n_prio[0] - 1, trace->q_max[0],
+                  trace->quality, trace->len[0], priority);
+  }
+  int k = trace->k - trace_cost(trace, 0, priority) -
+          trace_cost(trace, i, priority) + trace->cost_out;
+
+  if (trace->n_prio[i] == 0) {
+    k += p > trace->q_max[i];
+  } else {
+    int *prio = trace->prio + i * (trace->n_tiers + 1);
+    prio[0] = p;
+    k += step_cost(prio, trace->n_prio[i] + 1, trace->q_max[i],
+                   trace->quality + i * trace->n_stacks, trace->len[i],
+                   priority);
   }
 
-  return state->n_bad + k;
+  return n_bad + k;
 }
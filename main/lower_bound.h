@@ -34,4 +34,86 @@
 int lb4(state_t *state, int max_k, int *h, int *list, int *quality,
         int *priority);
 
+typedef int (*lb4_t)(state_t *state, int max_k, int *h, int *list,
+                     int *quality, int *priority);
+
+/**
+ * Find the LB4 kernel for a bay shape, which is specialized with constant
+ * dimensions if the shape is in KERNEL_SHAPES and lb4 otherwise
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @return LB4 kernel
+ */
+lb4_t find_lb4(int n_stacks, int n_tiers);
+
+typedef struct {
+  int n_stacks;   // number of stacks
+  int n_tiers;    // number of tiers
+  state_t *state; // the traced state
+  int k;          // total number of additional relocations
+  int cost_out;   // additional relocations counted at the first step once its
+                  // topmost block is moved out, -1 if not computed yet
+  int n_steps;    // number of steps simulated so far
+  int remain;     // number of badly-placed blocks not processed yet
+  int curr_q_max; // largest quality of non-full stacks at the next step
+  int *h;         // h[s]: height of stack s at the next step
+  int *list;      // list[i]: i-th stack in the ordered list at the next step
+  int *step;      // step[s]: first step processing stack s, -1 if not yet
+  int *q_max;     // q_max[i]: largest quality of non-full stacks at step i
+  int *cost;      // cost[i]: additional relocations counted at step i, -1 if
+                  // not computed yet
+  int *len;       // len[i]: number of qualities at step i
+  int *quality;   // quality[i * n_stacks + j]: j-th quality at step i
+  int *n_prio;    // n_prio[i]: number of badly-placed blocks at step i
+  int *prio;      // prio[i * (n_tiers + 1) + j]: j-th badly-placed block from
+                  // the top, where j = 0 is left for a block relocated onto it
+} trace_t;
+
+/**
+ * Create space for the trace of LB4
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @return created trace
+ */
+trace_t *malloc_trace(int n_stacks, int n_tiers);
+
+/**
+ * Free the space of a trace
+ *
+ * @param trace the trace
+ */
+void free_trace(trace_t *trace);
+
+/**
+ * Start tracing LB4 of a state so that LB4 of children can be derived by
+ * lb4_child. The steps of the simulation, and the additional relocations of
+ * each step, are only computed when a child needs them, so the body of the
+ * state must not change while the trace is used.
+ *
+ * @param state the state
+ * @param k additional relocations of the state, i.e., LB4 minus n_bad, which
+ *          must be exact
+ * @param trace the trace
+ */
+void lb4_trace(state_t *state, int k, trace_t *trace);
+
+/**
+ * Compute the value of LB4 of a child from the trace of its parent. The child
+ * must be obtained by relocating the topmost block of the first stack of the
+ * parent onto a non-full stack, where it is badly placed and the stack does
+ * not become full, possibly followed by retrievals, which are exactly the
+ * steps of the simulation that count nothing. The two simulations then differ
+ * only at the steps processing the source and destination stacks.
+ *
+ * @param trace trace of the parent
+ * @param n_bad number of badly-placed blocks of the child
+ * @param p priority of the relocated block
+ * @param d destination stack
+ * @param priority temporary array
+ * @return LB4 of the child, or -1 if it cannot be derived from the trace
+ */
+int lb4_child(trace_t *trace, int n_bad, int p, int d, int *priority);
+
 #endif
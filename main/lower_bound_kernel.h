@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Template of LB4, included by lower_bound.c once per kernel. Before the
+ * inclusion, KERNEL(name) must decorate the names of the kernel, and
+ * KERNEL_STACKS and KERNEL_TIERS must give the dimensions, which are either
+ * constants of a specialized bay shape or read from the state. The body
+ * matrices are indexed as flat arrays with stride KERNEL_TIERS + 1, so that
+ * constant dimensions turn every bound and offset into an immediate.
+ */
+
+static inline void KERNEL(adjust_right)(int s, int *h, int *list,
+                                        const cell_t *q, int n_stacks,
+                                        int n_tiers) {
+  (void)n_stacks;
+  (void)n_tiers;
+  int i = 0;
+  int q_s = q[s * (KERNEL_TIERS + 1) + h[s]];
+  while (i < KERNEL_STACKS - 1 &&
+         q_s > q[list[i + 1] * (KERNEL_TIERS + 1) + h[list[i + 1]]]) {
+    list[i] = list[i + 1];
+    i++;
+  }
+  list[i] = s;
+}
+
+int KERNEL(lb4)(state_t *state, int max_k, int *h, int *list, int *quality,
+                int *priority) {
+  if (state->n_bad == 0 || max_k == 0) {
+    return state->n_bad;
+  }
+
+  int n_stacks = state->n_stacks;
+  int n_tiers = state->n_tiers;
+  int remain = state->n_bad;
+  const cell_t *p = state->p[0];
+  const cell_t *q = state->q[0];
+  const cell_t *b = state->b[0];
+  (void)n_stacks;
+  (void)n_tiers;
+
+  memcpy(h, state->h, sizeof(int) * KERNEL_STACKS);
+  memcpy(list, state->list, sizeof(int) * KERNEL_STACKS);
+
+  int q_max;
+  for (int i = KERNEL_STACKS - 1;; i--) {
+    int s = list[i];
+    if (h[s] < KERNEL_TIERS) {
+      q_max = q[s * (KERNEL_TIERS + 1) + h[s]];
+      break;
+    }
+  }
+
+  int k = 0;
+  while (remain > 0) {
+    int s_min = list[0];
+    const cell_t *p_min = p + s_min * (KERNEL_TIERS + 1);
+    int bad_cnt = b[s_min * (KERNEL_TIERS + 1) + h[s_min]];
+
+    int n_bad = 0;
+    for (int t = h[s_min]; t > h[s_min] - bad_cnt; t--) {
+      if (p_min[t] > q_max) {
+        if (++k >= max_k) {
+          return state->n_bad + k;
+        }
+      } else {
+        priority[n_bad++] = p_min[t];
+      }
+    }
+
+    if (n_bad > 1) {
+      int len = 0;
+      for (int i = 1; i < KERNEL_STACKS; i++) {
+        int s = list[i];
+        if (h[s] < KERNEL_TIERS) {
+          quality[len++] = q[s * (KERNEL_TIERS + 1) + h[s]];
+        }
+      }
+
+      if ((k += relocate_cost(priority, n_bad, quality, len)) >= max_k) {
+        return state->n_bad + k;
+      }
+    }
+
+    remain -= bad_cnt;
+    h[s_min] -= bad_cnt + 1;
+
+    KERNEL(adjust_right)(s_min, h, list, q, n_stacks, n_tiers);
+
+    int q_min = q[s_min * (KERNEL_TIERS + 1) + h[s_min]];
+    if (q_max < q_min) {
+      q_max = q_min;
+    }
+  }
+
+  return state->n_bad + k;
+}
+
+#undef KERNEL
+#undef KERNEL_STACKS
+#undef KERNEL_TIERS
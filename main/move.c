@@ -16,7 +16,10 @@
  */
 
 #include "move.h"
+#include <ctype.h>
 #include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
 
 void print_moves(FILE *fp, move_t *path, int len) {
   if (len == INT_MAX) {
@@ -30,3 +33,49 @@ void print_moves(FILE *fp, move_t *path, int len) {
     fprintf(fp, "]\n");
   }
 }
+
+move_t *read_moves(char *input, int *len) {
+  FILE *fp = fopen(input, "r");
+  if (fp == NULL) {
+    return NULL;
+  }
+
+  int capacity = 64;
+  int n = 0;
+  int *values = malloc(sizeof(int) * capacity);
+  bool digits = false;
+  for (int c; (c = fgetc(fp)) != EOF;) {
+    if (c == '#') {
+      while ((c = fgetc(fp)) != EOF && c != '\n') {
+      }
+      digits = false;
+    } else if (isdigit(c)) {
+      if (!digits) {
+        if (n == capacity) {
+          capacity *= 2;
+          values = realloc(values, sizeof(int) * capacity);
+        }
+        values[n++] = 0;
+        digits = true;
+      }
+      values[n - 1] = values[n - 1] * 10 + (c - '0');
+    } else {
+      digits = false;
+    }
+  }
+  fclose(fp);
+
+  if (n % 3 != 0) {
+    free(values);
+    return NULL;
+  }
+  *len = n / 3;
+  move_t *path = malloc(sizeof(move_t) * (*len > 0 ? *len : 1));
+  for (int i = 0; i < *len; i++) {
+    path[i].p = values[3 * i];
+    path[i].s = values[3 * i + 1];
+    path[i].d = values[3 * i + 2];
+  }
+  free(values);
+  return path;
+}
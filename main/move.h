@@ -35,4 +35,15 @@ typedef struct {
  */
 void print_moves(FILE *fp, move_t *path, int len);
 
+/**
+ * Read moves as triples of priority, source and destination, where all
+ * characters other than digits separate numbers and '#' starts a comment, so
+ * that the output of print_moves can be read back
+ *
+ * @param input input file
+ * @param len number of moves read
+ * @return array of moves, or NULL if failed
+ */
+move_t *read_moves(char *input, int *len);
+
 #endif
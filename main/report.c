@@ -16,9 +16,13 @@
  */
 
 #include "report.h"
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+const char *rule_names[N_RULES] = {"empty", "transitive", "retrieval",
+                                   "exchange", "symmetry"};
+
 report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
                      move_t *best_sol, double time_to_best_lb,
                      double time_to_best_ub, double time_used, long n_nodes,
@@ -37,6 +41,176 @@ report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
   report->time_used = time_used;
   report->n_nodes = n_nodes;
   report->n_probe = n_probe;
+  report->n_threads = 1;
+  report->n_steal = 0;
+  report->n_table_lookup = 0;
+  report->n_table_hit = 0;
+  report->n_table_cut = 0;
+  report->n_table_store = 0;
+  report->n_table_reject = 0;
+  report->table_bytes = 0;
+  report->peak_bytes = 0;
+  memset(report->n_rule_cut, 0, sizeof(report->n_rule_cut));
+  report->n_configs = 0;
+  report->winner = -1;
+  report->lb_config = -1;
+  report->ub_config = -1;
+  memset(&report->stats, 0, sizeof(stats_t));
+  report->n_iterations = 0;
+  report->n_levels = 0;
+  report->profile = NULL;
+  report->bounds = NULL;
+  return report;
+}
+
+void print_report_json(FILE *fp, report_t *report) {
+  fprintf(fp,
+          "{\"event\": \"end\", \"init_lb\": %d, \"init_ub\": %d, "
+          "\"best_lb\": %d, \"best_ub\": %d, \"time_to_best_lb\": %.3f, "
+          "\"time_to_best_ub\": %.3f, \"time_used\": %.3f, \"nodes\": %ld, "
+          "\"probe\": %ld, \"threads\": %d, \"steal\": %ld, "
+          "\"table_lookup\": %ld, \"table_hit\": %ld, \"table_cut\": %ld, "
+          "\"table_store\": %ld, \"table_reject\": %ld, "
+          "\"table_bytes\": %zu, \"peak_bytes\": %zu, \"rule_cut\": {",
+          report->init_lb, report->init_ub, report->best_lb, report->best_ub,
+          report->time_to_best_lb, report->time_to_best_ub, report->time_used,
+          report->n_nodes, report->n_probe, report->n_threads, report->n_steal,
+          report->n_table_lookup, report->n_table_hit, report->n_table_cut,
+          report->n_table_store, report->n_table_reject, report->table_bytes,
+          report->peak_bytes);
+  for (int r = 0; r < N_RULES; r++) {
+    fprintf(fp, "%s\"%s\": %ld", r == 0 ? "" : ", ", rule_names[r],
+            report->n_rule_cut[r]);
+  }
+  fprintf(fp, "}");
+  if (report->n_configs > 0) {
+    fprintf(fp,
+            ", \"portfolio\": {\"configs\": %d, \"winner\": %d, "
+            "\"lb_config\": %d, \"ub_config\": %d}",
+            report->n_configs, report->winner, report->lb_config,
+            report->ub_config);
+  }
+  fprintf(fp, ", \"moves\": [");
+  for (int i = 0; report->best_sol != NULL && i < report->best_ub; i++) {
+    fprintf(fp, "%s{\"p\": %d, \"s\": %d, \"d\": %d}", i == 0 ? "" : ", ",
+            report->best_sol[i].p, report->best_sol[i].s,
+            report->best_sol[i].d);
+  }
+  fprintf(fp, "]");
+  if (SEARCH_STATS) {
+    fprintf(fp, ", \"stats\": ");
+    print_stats_json(fp, &report->stats);
+  }
+  fprintf(fp, "}\n");
+  fflush(fp);
+}
+
+void print_profile(FILE *fp, report_t *report) {
+  fprintf(fp, "{\"iterations\": [");
+  for (int i = 0; i < report->n_iterations; i++) {
+    level_profile_t *profile = report->profile + i * report->n_levels;
+    int n_levels = report->n_levels;
+    while (n_levels > 0 && profile[n_levels - 1].n_nodes == 0) {
+      n_levels--;
+    }
+
+    fprintf(fp, "%s\n  {\"bound\": %d, \"levels\": [", i == 0 ? "" : ",",
+            report->bounds[i]);
+    for (int l = 0; l < n_levels; l++) {
+      long next = l + 1 < n_levels ? profile[l + 1].n_nodes : 0;
+      fprintf(fp,
+              "%s\n    {\"level\": %d, \"nodes\": %ld, \"branches\": %ld, "
+              "\"pruned\": %ld, \"branching\": %.3f, \"slack\": [",
+              l == 0 ? "" : ",", l, profile[l].n_nodes, profile[l].n_branches,
+              profile[l].n_pruned,
+              profile[l].n_nodes > 0 ? (double)next / profile[l].n_nodes : 0.0);
+      for (int k = 0; k < N_SLACK; k++) {
+        fprintf(fp, "%s%ld", k == 0 ? "" : ", ", profile[l].slack[k]);
+      }
+      fprintf(fp, "]}");
+    }
+    fprintf(fp, "]}");
+  }
+  fprintf(fp, "\n]}\n");
+  fflush(fp);
+}
+
+/*
+ * Report record of a binary archive: the bounds and the number of moves as
+ * 32-bit integers, the times as doubles, the counters as 64-bit integers and
+ * the moves as triples of 32-bit integers
+ */
+bool store_report(archive_t *archive, long k, report_t *report) {
+  if (!archive->writable || k < 0 || k >= archive->n_instances) {
+    return false;
+  }
+  int n_moves = report->best_sol != NULL ? report->best_ub : 0;
+  int32_t bounds[5] = {report->init_lb, report->init_ub, report->best_lb,
+                       report->best_ub, n_moves};
+  double times[3] = {report->time_to_best_lb, report->time_to_best_ub,
+                     report->time_used};
+  int64_t counters[2] = {report->n_nodes, report->n_probe};
+  int32_t *moves = malloc(sizeof(int32_t) * 3 * (n_moves + 1));
+  for (int i = 0; i < n_moves; i++) {
+    moves[3 * i] = report->best_sol[i].p;
+    moves[3 * i + 1] = report->best_sol[i].s;
+    moves[3 * i + 2] = report->best_sol[i].d;
+  }
+
+  FILE *fp = archive->fp;
+  bool ok = fseeko(fp, (off_t)archive->end, SEEK_SET) == 0 &&
+            fwrite(bounds, sizeof(int32_t), 5, fp) == 5 &&
+            fwrite(times, sizeof(double), 3, fp) == 3 &&
+            fwrite(counters, sizeof(int64_t), 2, fp) == 2 &&
+            fwrite(moves, sizeof(int32_t), 3 * n_moves, fp) ==
+                (size_t)(3 * n_moves);
+  free(moves);
+  if (!ok) {
+    return false;
+  }
+
+  archive->index[2 * k + 1] = archive->end;
+  archive->end += sizeof(int32_t) * 5 + sizeof(double) * 3 +
+                  sizeof(int64_t) * 2 + sizeof(int32_t) * 3 * n_moves;
+  archive->dirty = true;
+  return true;
+}
+
+report_t *load_report(archive_t *archive, long k) {
+  if (k < 0 || k >= archive->n_instances || archive->index[2 * k + 1] == 0) {
+    return NULL;
+  }
+  int32_t bounds[5];
+  double times[3];
+  int64_t counters[2];
+  FILE *fp = archive->fp;
+  if (fseeko(fp, (off_t)archive->index[2 * k + 1], SEEK_SET) != 0 ||
+      fread(bounds, sizeof(int32_t), 5, fp) != 5 ||
+      fread(times, sizeof(double), 3, fp) != 3 ||
+      fread(counters, sizeof(int64_t), 2, fp) != 2 || bounds[4] < 0) {
+    return NULL;
+  }
+
+  int n_moves = bounds[4];
+  int32_t *moves = malloc(sizeof(int32_t) * 3 * (n_moves + 1));
+  if (fread(moves, sizeof(int32_t), 3 * n_moves, fp) != (size_t)(3 * n_moves)) {
+    free(moves);
+    return NULL;
+  }
+  move_t *best_sol = n_moves > 0 ? malloc(sizeof(move_t) * n_moves) : NULL;
+  for (int i = 0; i < n_moves; i++) {
+    best_sol[i].p = moves[3 * i];
+    best_sol[i].s = moves[3 * i + 1];
+    best_sol[i].d = moves[3 * i + 2];
+  }
+  free(moves);
+
+  report_t *report = new_report(bounds[0], bounds[1], bounds[2],
+                                n_moves > 0 ? n_moves : bounds[3], best_sol,
+                                times[0], times[1], times[2], counters[0],
+                                counters[1]);
+  report->best_ub = bounds[3];
+  free(best_sol);
   return report;
 }
 
@@ -44,5 +218,7 @@ void free_report(report_t *report) {
   if (report->best_sol != NULL) {
     free(report->best_sol);
   }
+  free(report->profile);
+  free(report->bounds);
   free(report);
 }
@@ -18,7 +18,41 @@
 #ifndef REPORT_H
 #define REPORT_H
 
+#include "instance.h"
 #include "move.h"
+#include "stats.h"
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Number of buckets of the slack histogram, where the last bucket collects
+ * all larger slacks
+ */
+#define N_SLACK 8
+
+/*
+ * Dominance rules of the branching, which can be disabled one by one
+ */
+typedef enum {
+  RULE_EMPTY,      // relocation to the leftmost empty stack only
+  RULE_TRANSITIVE, // no relocation to a stack unchanged since the last one
+  RULE_RETRIEVAL,  // no retrieval that could come from a stack to the left
+  RULE_EXCHANGE,   // no retrieval that could come from a lower stack
+  RULE_SYMMETRY,   // no relocation to a stack equal to one to the left
+  N_RULES
+} rule_t;
+
+/*
+ * Names of the dominance rules, as used on command lines and in reports
+ */
+extern const char *rule_names[N_RULES];
+
+typedef struct {
+  long n_nodes;         // number of nodes at the level
+  long n_branches;      // number of non-dominated branches
+  long n_pruned;        // number of branches pruned by rules or bounds
+  long slack[N_SLACK];  // slack[k]: branches whose child_lb is k below limit
+} level_profile_t;
 
 typedef struct {
   int init_lb;            // initial lower bound
@@ -31,10 +65,29 @@ typedef struct {
   double time_used;       // total time used in seconds
   long n_nodes;           // number of nodes explored
   long n_probe;           // number of nodes probed
+  int n_threads;          // number of search threads
+  long n_steal;           // number of subtrees stolen by idle threads
+  long n_table_lookup;    // number of transposition table lookups
+  long n_table_hit;       // number of transposition table hits
+  long n_table_cut;       // number of nodes pruned by transposition table
+  long n_table_store;     // number of transposition table stores
+  long n_table_reject;    // number of stores rejected by replacement policy
+  size_t table_bytes;     // memory of the transposition table in bytes
+  size_t peak_bytes;      // peak memory of the solver in bytes
+  long n_rule_cut[N_RULES]; // n_rule_cut[r]: branches pruned by rule r
+  int n_configs;          // number of portfolio configurations, 0 if none
+  int winner;             // configuration closing the gap first, -1 if none
+  int lb_config;          // configuration proving best_lb, -1 if the root
+  int ub_config;          // configuration finding best_sol, -1 if initial
+  stats_t stats;          // hot-path statistics, zero unless SEARCH_STATS
+  int n_iterations;       // number of iterations profiled, 0 if disabled
+  int n_levels;           // number of levels per iteration
+  level_profile_t *profile; // profile[i * n_levels + l]: level l of iter. i
+  int *bounds;            // bounds[i]: depth bound of iteration i
 } report_t;
 
 /**
- * Create a report
+ * Create a report for a single-threaded search
  *
  * @param init_lb initial lower bound
  * @param init_ub initial upper bound
@@ -53,6 +106,45 @@ report_t *new_report(int init_lb, int init_ub, int best_lb, int best_ub,
                      double time_to_best_ub, double time_used, long n_nodes,
                      long n_probe);
 
+/**
+ * Write a report as a JSON line of the end event, with the best solution as
+ * a list of moves
+ *
+ * @param fp output stream
+ * @param report the report
+ */
+void print_report_json(FILE *fp, report_t *report);
+
+/**
+ * Store the report of the k-th instance of a binary archive, i.e., the bounds,
+ * times, counters and best solution, replacing any previous one whose space
+ * is not reclaimed
+ *
+ * @param archive the archive, which must be writable
+ * @param k index of the instance, from 0
+ * @param report the report
+ * @return false if the record cannot be written
+ */
+bool store_report(archive_t *archive, long k, report_t *report);
+
+/**
+ * Load the stored report of the k-th instance of a binary archive
+ *
+ * @param archive the archive
+ * @param k index of the instance, from 0
+ * @return created report, or NULL if none is stored
+ */
+report_t *load_report(archive_t *archive, long k);
+
+/**
+ * Write the per-depth profile of a report as JSON, labelling each iteration
+ * with its depth bound
+ *
+ * @param fp output stream
+ * @param report the report
+ */
+void print_profile(FILE *fp, report_t *report);
+
 /**
  * Free the space of a report
  *
@@ -0,0 +1,437 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "algorithm.h"
+#include "state.h"
+#include "timer.h"
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * Number of recent requests kept for the latency percentiles
+ */
+#define N_LATENCY 4096
+
+/*
+ * Number of solvers kept by a worker beyond the warm ones, where the least
+ * recently used is evicted for other bay dimensions
+ */
+#define N_CACHED 8
+
+typedef struct {
+  int n_stacks;
+  int n_tiers;
+  long used; // request count of the worker at the last use
+  solver_t *solver;
+} cached_solver_t;
+
+typedef struct job {
+  instance_t *inst;
+  int time_limit;
+  report_t *report;
+  run_status_t status;
+  double arrival;
+  bool done;
+  pthread_cond_t done_cond;
+  struct job *next;
+} job_t;
+
+/*
+ * Shared by all threads, guarded by queue_lock
+ */
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static job_t *queue_head;
+static job_t *queue_tail;
+static int queue_depth;
+static int n_busy;
+static long n_served;
+static double latency[N_LATENCY];
+static bool stopping;
+
+/*
+ * Parameters
+ */
+static int n_warm;
+static int warm_stacks[64];
+static int warm_tiers[64];
+static bool specialized = true;
+static int listen_fd = -1;
+
+static void usage(void) {
+  fprintf(stdout, "usage: rcrp-server -h\n");
+  fprintf(stdout, "usage: rcrp-server"
+                  " --socket/-S socket_path"
+                  " --workers/-w n_workers"
+                  " --warm/-W n_stacks x n_tiers"
+                  " [--generic/-g]\n");
+  fprintf(stdout, "\t--socket/-S: path of the Unix domain socket\n");
+  fprintf(stdout, "\t--workers/-w: number of worker threads\n");
+  fprintf(stdout, "\t--warm/-W: bay dimensions such as 6x5 whose solvers are"
+                  " allocated at startup, which can be repeated\n");
+  fprintf(stdout, "\t--generic/-g: use generic kernels for all bay shapes\n");
+  fprintf(stdout, "requests, one per line:\n");
+  fprintf(stdout, "\tSOLVE time_limit n_stacks n_tiers n_blocks h1 p[1][1]"
+                  " ... p[1][h1] ... hS p[S][1] ... p[S][hS]\n");
+  fprintf(stdout, "\t\t-> OK status best_lb best_ub time nodes probe n_moves"
+                  " p s d ... or ERR message\n");
+  fprintf(stdout, "\tSTATS -> STATS queue busy served p50 p90 p99 max,"
+                  " latencies in ms\n");
+  fprintf(stdout, "\tQUIT closes the connection, SHUTDOWN stops the"
+                  " server\n");
+  fflush(stdout);
+}
+
+/*
+ * Workers, each keeping a bounded cache of solvers keyed by bay dimensions
+ */
+static solver_t *find_solver(cached_solver_t *cache, int capacity, int *size,
+                             long *n_used, int n_stacks, int n_tiers) {
+  (*n_used)++;
+  for (int i = 0; i < *size; i++) {
+    if (cache[i].n_stacks == n_stacks && cache[i].n_tiers == n_tiers) {
+      cache[i].used = *n_used;
+      return cache[i].solver;
+    }
+  }
+
+  params_t params;
+  default_params(&params);
+  params.verbose = false;
+  params.wall_clock = true;
+  params.specialized = specialized;
+
+  cached_solver_t *entry = &cache[0];
+  if (*size < capacity) {
+    entry = &cache[(*size)++];
+  } else {
+    for (int i = 1; i < *size; i++) {
+      if (cache[i].used < entry->used) {
+        entry = &cache[i];
+      }
+    }
+    free_solver(entry->solver);
+  }
+  entry->n_stacks = n_stacks;
+  entry->n_tiers = n_tiers;
+  entry->used = *n_used;
+  entry->solver = malloc_solver(n_stacks, n_tiers, &params);
+  return entry->solver;
+}
+
+static void *work(void *arg) {
+  (void)arg;
+  int capacity = n_warm + N_CACHED;
+  cached_solver_t *cache = malloc(sizeof(cached_solver_t) * capacity);
+  int size = 0;
+  long n_used = 0;
+  for (int i = 0; i < n_warm; i++) {
+    find_solver(cache, capacity, &size, &n_used, warm_stacks[i],
+                warm_tiers[i]);
+  }
+
+  pthread_mutex_lock(&queue_lock);
+  while (true) {
+    while (queue_head == NULL && !stopping) {
+      pthread_cond_wait(&queue_cond, &queue_lock);
+    }
+    if (queue_head == NULL) {
+      break;
+    }
+    job_t *job = queue_head;
+    queue_head = job->next;
+    if (queue_head == NULL) {
+      queue_tail = NULL;
+    }
+    queue_depth--;
+    n_busy++;
+    pthread_mutex_unlock(&queue_lock);
+
+    solver_t *solver = find_solver(cache, capacity, &size, &n_used,
+                                   job->inst->n_stacks, job->inst->n_tiers);
+    report_t *report = run_solver(solver, job->inst, job->time_limit);
+
+    pthread_mutex_lock(&queue_lock);
+    job->report = report;
+    job->status = run_status(solver);
+    job->done = true;
+    n_busy--;
+    latency[n_served++ % N_LATENCY] = get_wall_time() - job->arrival;
+    pthread_cond_signal(&job->done_cond);
+  }
+  pthread_mutex_unlock(&queue_lock);
+
+  for (int i = 0; i < size; i++) {
+    free_solver(cache[i].solver);
+  }
+  free(cache);
+  return NULL;
+}
+
+static bool submit(instance_t *inst, int time_limit, double arrival,
+                   report_t **report, run_status_t *status) {
+  pthread_mutex_lock(&queue_lock);
+  if (stopping) {
+    pthread_mutex_unlock(&queue_lock);
+    return false; // no worker may be left to take the job
+  }
+
+  job_t job;
+  job.inst = inst;
+  job.time_limit = time_limit;
+  job.report = NULL;
+  job.arrival = arrival;
+  job.done = false;
+  job.next = NULL;
+  pthread_cond_init(&job.done_cond, NULL);
+
+  if (queue_tail == NULL) {
+    queue_head = &job;
+  } else {
+    queue_tail->next = &job;
+  }
+  queue_tail = &job;
+  queue_depth++;
+  pthread_cond_signal(&queue_cond);
+  while (!job.done) {
+    pthread_cond_wait(&job.done_cond, &queue_lock);
+  }
+  pthread_mutex_unlock(&queue_lock);
+
+  pthread_cond_destroy(&job.done_cond);
+  *report = job.report;
+  *status = job.status;
+  return true;
+}
+
+/*
+ * Requests of a connection
+ */
+static int compare_latency(const void *a, const void *b) {
+  double x = *(double *)a;
+  double y = *(double *)b;
+  return (x > y) - (x < y);
+}
+
+static void write_stats(FILE *out) {
+  static double sorted[N_LATENCY];
+  pthread_mutex_lock(&queue_lock);
+  int depth = queue_depth;
+  int busy = n_busy;
+  long served = n_served;
+  int n = served < N_LATENCY ? (int)served : N_LATENCY;
+  memcpy(sorted, latency, sizeof(double) * n);
+  pthread_mutex_unlock(&queue_lock);
+
+  qsort(sorted, n, sizeof(double), compare_latency);
+  fprintf(out, "STATS %d %d %ld %.3f %.3f %.3f %.3f\n", depth, busy, served,
+          n > 0 ? 1000 * sorted[n / 2] : 0.0,
+          n > 0 ? 1000 * sorted[n * 9 / 10] : 0.0,
+          n > 0 ? 1000 * sorted[n * 99 / 100] : 0.0,
+          n > 0 ? 1000 * sorted[n - 1] : 0.0);
+}
+
+static void write_report(FILE *out, report_t *report) {
+  fprintf(out, "OK %s %d %d %.6f %ld %ld %d",
+          report->best_lb == report->best_ub ? "optimal" : "timeout",
+          report->best_lb, report->best_ub, report->time_used,
+          report->n_nodes, report->n_probe,
+          report->best_sol != NULL ? report->best_ub : 0);
+  for (int i = 0; report->best_sol != NULL && i < report->best_ub; i++) {
+    fprintf(out, " %d %d %d", report->best_sol[i].p, report->best_sol[i].s,
+            report->best_sol[i].d);
+  }
+  fprintf(out, "\n");
+}
+
+static void solve_request(FILE *out, char *args, size_t len, double arrival) {
+  char *next;
+  int time_limit = (int)strtol(args, &next, 10);
+  if (next == args || time_limit < 0) {
+    fprintf(out, "ERR missing time limit\n");
+    return;
+  }
+
+  /*
+   * Reject bays whose slots do not fit in cells before allocating for them
+   */
+  char *end;
+  long n_stacks = strtol(next, &end, 10);
+  long n_tiers = strtol(end, NULL, 10);
+  if (n_stacks > 0 && n_tiers > 0 &&
+      (n_stacks >= CELL_MAX || n_tiers >= CELL_MAX ||
+       n_stacks * n_tiers >= CELL_MAX)) {
+    fprintf(out, "ERR bay too large\n");
+    return;
+  }
+
+  instance_reader_t *reader =
+      open_instances_buffer("request", next, len - (size_t)(next - args));
+  instance_t *inst;
+  bool ok = next_instance(reader, &inst);
+  close_instances(reader);
+  if (!ok || inst == NULL) {
+    fprintf(out, "ERR malformed instance\n");
+    return;
+  }
+
+  report_t *report;
+  run_status_t status;
+  if (!submit(inst, time_limit, arrival, &report, &status)) {
+    fprintf(out, "ERR shutting down\n");
+  } else if (report == NULL) {
+    fprintf(out, status == RUN_INFEASIBLE ? "ERR infeasible\n"
+                                          : "ERR unsolved\n");
+  } else {
+    write_report(out, report);
+    free_report(report);
+  }
+  free_instance(inst);
+}
+
+static void *serve(void *arg) {
+  int fd = (int)(intptr_t)arg;
+  FILE *in = fdopen(fd, "r");
+  FILE *out = fdopen(dup(fd), "w");
+  char *line = NULL;
+  size_t capacity = 0;
+
+  for (ssize_t len; (len = getline(&line, &capacity, in)) > 0;) {
+    double arrival = get_wall_time();
+    if (strncmp(line, "SOLVE", 5) == 0) {
+      solve_request(out, line + 5, (size_t)len - 5, arrival);
+    } else if (strncmp(line, "STATS", 5) == 0) {
+      write_stats(out);
+    } else if (strncmp(line, "QUIT", 4) == 0) {
+      break;
+    } else if (strncmp(line, "SHUTDOWN", 8) == 0) {
+      pthread_mutex_lock(&queue_lock);
+      stopping = true;
+      pthread_cond_broadcast(&queue_cond);
+      pthread_mutex_unlock(&queue_lock);
+      shutdown(listen_fd, SHUT_RDWR);
+      break;
+    } else {
+      fprintf(out, "ERR unknown request\n");
+    }
+    fflush(out);
+  }
+
+  free(line);
+  fclose(in);
+  fclose(out);
+  return NULL;
+}
+
+int main(int argc, char **argv) {
+  char *opts = "hS:w:W:g";
+  struct option options[] = {{"help", no_argument, NULL, 'h'},
+                             {"socket", required_argument, NULL, 'S'},
+                             {"workers", required_argument, NULL, 'w'},
+                             {"warm", required_argument, NULL, 'W'},
+                             {"generic", no_argument, NULL, 'g'},
+                             {NULL, 0, NULL, 0}};
+
+  char *socket_path = "/tmp/rcrp.sock";
+  int n_workers = 1;
+
+  for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
+    switch (opt) {
+    case 'h':
+      usage();
+      return EXIT_SUCCESS;
+    case 'S':
+      socket_path = optarg;
+      break;
+    case 'w':
+      n_workers = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'W':
+      if (n_warm == 64 ||
+          sscanf(optarg, "%dx%d", &warm_stacks[n_warm],
+                 &warm_tiers[n_warm]) != 2 ||
+          warm_stacks[n_warm] < 1 || warm_tiers[n_warm] < 1 ||
+          warm_stacks[n_warm] >= CELL_MAX || warm_tiers[n_warm] >= CELL_MAX ||
+          warm_stacks[n_warm] * warm_tiers[n_warm] >= CELL_MAX) {
+        fprintf(stderr, "Invalid bay dimensions: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      n_warm++;
+      break;
+    case 'g':
+      specialized = false;
+      break;
+    default:
+      fprintf(stderr, "Unknown option: %c\n", opt);
+      return EXIT_FAILURE;
+    }
+  }
+  if (n_workers < 1) {
+    n_workers = 1;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path is too long: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  strcpy(addr.sun_path, socket_path);
+  unlink(socket_path);
+  listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0 ||
+      bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+      listen(listen_fd, 64) != 0) {
+    fprintf(stderr, "Failed to listen on socket: %s\n", socket_path);
+    return EXIT_FAILURE;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  pthread_t *threads = malloc(sizeof(pthread_t) * n_workers);
+  for (int i = 0; i < n_workers; i++) {
+    pthread_create(&threads[i], NULL, work, NULL);
+  }
+  fprintf(stderr, "listening on %s with %d workers\n", socket_path,
+          n_workers);
+
+  for (int fd; (fd = accept(listen_fd, NULL, NULL)) >= 0;) {
+    pthread_t thread;
+    pthread_create(&thread, NULL, serve, (void *)(intptr_t)fd);
+    pthread_detach(thread);
+  }
+
+  pthread_mutex_lock(&queue_lock);
+  stopping = true;
+  pthread_cond_broadcast(&queue_cond);
+  pthread_mutex_unlock(&queue_lock);
+  for (int i = 0; i < n_workers; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  close(listen_fd);
+  unlink(socket_path);
+  fprintf(stderr, "served = %ld\n", n_served);
+
+  return EXIT_SUCCESS;
+}
@@ -17,15 +17,79 @@
 
 #include "algorithm.h"
 #include <getopt.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 static void usage(void) {
   fprintf(stdout, "usage: main-solve -h\n");
   fprintf(stdout, "usage: main-solve"
                   " --input/-i input_file"
-                  " --time_limit/-t time_limit\n");
+                  " --time_limit/-t time_limit"
+                  " --threads/-n n_threads"
+                  " --table_size/-T table_size"
+                  " --table_policy/-P table_policy"
+                  " --profile/-p profile_file"
+                  " --events/-e event_stream"
+                  " --warm/-w moves_file"
+                  " --lower/-L lower_bound"
+                  " --upper/-U upper_bound"
+                  " --checkpoint/-c checkpoint_file"
+                  " --memory/-M memory_budget"
+                  " --rules/-R rule_list"
+                  " --config/-C order:probe_slack:rule_list"
+                  " [--resume/-r]"
+                  " [--quiet/-q]"
+                  " [--scaling/-s]"
+                  " [--generic/-g]"
+                  " [--kernels/-k]"
+                  " [--iterative/-I]"
+                  " [--engines/-E]\n");
   fprintf(stdout, "\t--input/-i: input file\n");
   fprintf(stdout, "\t--time_limit/-t: time limit in seconds\n");
+  fprintf(stdout, "\t--threads/-n: number of search threads\n");
+  fprintf(stdout, "\t--table_size/-T: transposition table size in MB"
+                  " (0 to disable)\n");
+  fprintf(stdout, "\t--table_policy/-P: replacement policy of transposition"
+                  " table (always or depth)\n");
+  fprintf(stdout, "\t--profile/-p: write the nodes, branches, prunes and"
+                  " slacks per iteration and level as JSON\n");
+  fprintf(stdout, "\t--events/-e: write progress events and the result as"
+                  " JSON lines to a file, a file descriptor number or - for"
+                  " stdout\n");
+  fprintf(stdout, "\t--warm/-w: warm-start from the moves in a file, given as"
+                  " triples of priority, source and destination\n");
+  fprintf(stdout, "\t--lower/-L: warm-start from a proven lower bound\n");
+  fprintf(stdout, "\t--upper/-U: warm-start from a claimed upper bound"
+                  " without a plan\n");
+  fprintf(stdout, "\t--checkpoint/-c: write the progress to a file when"
+                  " stopped by the time limit, SIGINT or SIGTERM\n");
+  fprintf(stdout, "\t--resume/-r: resume from the checkpoint file, which is"
+                  " removed once the instance is solved\n");
+  fprintf(stdout, "\t--memory/-M: memory budget of the solver in KB (0 for"
+                  " unlimited)\n");
+  fprintf(stdout, "\t--rules/-R: comma-separated dominance rules to enable"
+                  " (empty, transitive, retrieval, exchange, symmetry, all or"
+                  " none)\n");
+  fprintf(stdout, "\t--config/-C: add a configuration to a portfolio, i.e.,"
+                  " the order of equally bounded branches (high, low, left or"
+                  " right), the largest slack of the probed children and the"
+                  " dominance rules, where omitted fields keep the other"
+                  " options; the configurations run concurrently with"
+                  " n_threads each, share the incumbent and stop once one"
+                  " closes the gap, and no checkpoint is taken\n");
+  fprintf(stdout, "\t--quiet/-q: print neither the instance, the progress nor"
+                  " the result as text\n");
+  fprintf(stdout, "\t--scaling/-s: solve with 1, 2, 4, ..., n_threads threads"
+                  " and report the scaling\n");
+  fprintf(stdout, "\t--generic/-g: use generic kernels for all bay shapes\n");
+  fprintf(stdout, "\t--kernels/-k: solve with the generic and the specialized"
+                  " kernels and report the speedup\n");
+  fprintf(stdout, "\t--iterative/-I: search with an explicit stack instead"
+                  " of recursion\n");
+  fprintf(stdout, "\t--engines/-E: solve with the recursive and the"
+                  " iterative search and report the speedup\n");
   fprintf(stdout, "input format:\n");
   fprintf(stdout, "\tline 0: n_stacks n_tiers n_blocks\n");
   fprintf(stdout, "\tline 1: h1 p[1][1] ... p[1][h1]\n");
@@ -35,15 +99,222 @@ static void usage(void) {
   fflush(stdout);
 }
 
+static bool parse_rules(char *list, unsigned *rules) {
+  *rules = 0;
+  for (char *name = strtok(list, ","); name != NULL;
+       name = strtok(NULL, ",")) {
+    if (strcmp(name, "all") == 0) {
+      *rules = ALL_RULES;
+      continue;
+    } else if (strcmp(name, "none") == 0) {
+      continue;
+    }
+    int r = 0;
+    while (r < N_RULES && strcmp(name, rule_names[r]) != 0) {
+      r++;
+    }
+    if (r == N_RULES) {
+      fprintf(stderr, "Unknown rule: %s\n", name);
+      return false;
+    }
+    *rules |= 1u << r;
+  }
+  return true;
+}
+
+/*
+ * Parse a portfolio configuration, i.e., an order optionally followed by the
+ * largest probing slack and the rule list, separated by colons
+ */
+static bool parse_config(char *spec, params_t *config) {
+  char *slack = strchr(spec, ':');
+  if (slack != NULL) {
+    *slack++ = '\0';
+  }
+  char *rules = slack != NULL ? strchr(slack, ':') : NULL;
+  if (rules != NULL) {
+    *rules++ = '\0';
+  }
+  int o = 0;
+  while (o < N_ORDERS && strcmp(spec, order_names[o]) != 0) {
+    o++;
+  }
+  if (o == N_ORDERS) {
+    fprintf(stderr, "Unknown order: %s\n", spec);
+    return false;
+  }
+  config->order = (order_t)o;
+  if (slack != NULL && *slack != '\0') {
+    config->probe_slack = (int)strtol(slack, NULL, 10);
+  }
+  return rules == NULL || parse_rules(rules, &config->rules);
+}
+
+static void print_config(FILE *fp, params_t *config) {
+  fprintf(fp, "%s:%d:", order_names[config->order], config->probe_slack);
+  if (config->rules == 0 || config->rules == ALL_RULES) {
+    fprintf(fp, config->rules == 0 ? "none" : "all");
+    return;
+  }
+  for (int r = 0, n = 0; r < N_RULES; r++) {
+    if (config->rules & 1u << r) {
+      fprintf(fp, "%s%s", n++ == 0 ? "" : ",", rule_names[r]);
+    }
+  }
+}
+
+static solver_t *volatile running = NULL;
+static portfolio_t *volatile running_portfolio = NULL;
+static char *checkpoint_file = NULL;
+
+static void interrupt(int sig) {
+  (void)sig;
+  solver_t *solver = running;
+  if (solver != NULL) {
+    interrupt_solver(solver);
+  }
+  portfolio_t *portfolio = running_portfolio;
+  if (portfolio != NULL) {
+    interrupt_portfolio(portfolio);
+  }
+}
+
+static report_t *run(instance_t *inst, int time_limit, params_t *params,
+                     warm_start_t *warm) {
+  solver_t *solver = malloc_solver(inst->n_stacks, inst->n_tiers, params);
+  running = solver;
+  report_t *report = run_solver_warm(solver, inst, time_limit, warm);
+  running = NULL;
+  checkpoint_t *ckpt = take_checkpoint(solver);
+  if (ckpt != NULL && checkpoint_file != NULL) {
+    if (!write_checkpoint(checkpoint_file, ckpt)) {
+      fprintf(stderr, "Failed to write checkpoint to: %s\n", checkpoint_file);
+    }
+  } else if (ckpt == NULL && report != NULL && warm != NULL &&
+             warm->resume != NULL && match_checkpoint(warm->resume, inst)) {
+    remove(checkpoint_file); // the resumed run is finished
+  }
+  if (ckpt != NULL) {
+    free_checkpoint(ckpt);
+  }
+  free_solver(solver);
+  return report;
+}
+
+static report_t *run_configs(instance_t *inst, int time_limit,
+                             params_t *configs, int n_configs,
+                             warm_start_t *warm) {
+  portfolio_t *portfolio =
+      malloc_portfolio(inst->n_stacks, inst->n_tiers, configs, n_configs);
+  running_portfolio = portfolio;
+  report_t *report = run_portfolio(portfolio, inst, time_limit, warm);
+  running_portfolio = NULL;
+  free_portfolio(portfolio);
+  return report;
+}
+
+static void scale(instance_t *inst, int time_limit, params_t *params,
+                  warm_start_t *warm) {
+  int max_threads = params->n_threads;
+  int n_runs = 0;
+  report_t **reports = malloc(sizeof(report_t *) * (max_threads + 1));
+  for (int n = 1;; n = n * 2 > max_threads && n < max_threads ? max_threads
+                                                              : n * 2) {
+    params->n_threads = n;
+    reports[n_runs++] = run(inst, time_limit, params, warm);
+    if (n >= max_threads) {
+      break;
+    }
+  }
+
+  double base_time = reports[0]->time_used;
+  fprintf(stdout, "Scaling:\n");
+  fprintf(stdout, "%8s %8s %8s %12s %10s %12s %12s %8s\n", "threads",
+          "best_lb", "best_ub", "nodes", "steals", "time_to_ub", "time",
+          "speedup");
+  for (int i = 0; i < n_runs; i++) {
+    report_t *report = reports[i];
+    fprintf(stdout, "%8d %8d %8d %12ld %10ld %12.3f %12.3f %8.2f\n",
+            report->n_threads, report->best_lb, report->best_ub,
+            report->n_nodes, report->n_steal, report->time_to_best_ub,
+            report->time_used,
+            report->time_used > 0 ? base_time / report->time_used : 1.0);
+    free_report(report);
+  }
+  fflush(stdout);
+  free(reports);
+}
+
+/*
+ * Solve with a parameter switched off and on, and report the speedup
+ */
+static void compare(instance_t *inst, int time_limit, params_t *params,
+                    warm_start_t *warm, bool *flag, const char *title,
+                    const char *column, const char *names[2]) {
+  *flag = false;
+  report_t *off = run(inst, time_limit, params, warm);
+  *flag = true;
+  report_t *on = run(inst, time_limit, params, warm);
+
+  fprintf(stdout, "%s:\n", title);
+  fprintf(stdout, "%12s %8s %8s %12s %12s %14s %8s\n", column, "best_lb",
+          "best_ub", "nodes", "time", "nodes/s", "speedup");
+  report_t *reports[] = {off, on};
+  for (int i = 0; i < 2; i++) {
+    report_t *report = reports[i];
+    fprintf(stdout, "%12s %8d %8d %12ld %12.3f %14.0f %8.2f\n", names[i],
+            report->best_lb, report->best_ub, report->n_nodes,
+            report->time_used,
+            report->time_used > 0 ? report->n_nodes / report->time_used : 0.0,
+            report->time_used > 0 ? off->time_used / report->time_used : 1.0);
+  }
+  fflush(stdout);
+  free_report(off);
+  free_report(on);
+}
+
 int main(int argc, char **argv) {
-  char *opts = "hi:t:";
+  char *opts = "hi:t:n:T:P:p:e:w:L:U:c:rM:R:C:qsgkIE";
   struct option options[] = {{"help", no_argument, NULL, 'h'},
                              {"input", required_argument, NULL, 'i'},
                              {"time_limit", required_argument, NULL, 't'},
+                             {"threads", required_argument, NULL, 'n'},
+                             {"table_size", required_argument, NULL, 'T'},
+                             {"table_policy", required_argument, NULL, 'P'},
+                             {"profile", required_argument, NULL, 'p'},
+                             {"events", required_argument, NULL, 'e'},
+                             {"warm", required_argument, NULL, 'w'},
+                             {"lower", required_argument, NULL, 'L'},
+                             {"upper", required_argument, NULL, 'U'},
+                             {"checkpoint", required_argument, NULL, 'c'},
+                             {"resume", no_argument, NULL, 'r'},
+                             {"memory", required_argument, NULL, 'M'},
+                             {"rules", required_argument, NULL, 'R'},
+                             {"config", required_argument, NULL, 'C'},
+                             {"quiet", no_argument, NULL, 'q'},
+                             {"scaling", no_argument, NULL, 's'},
+                             {"generic", no_argument, NULL, 'g'},
+                             {"kernels", no_argument, NULL, 'k'},
+                             {"iterative", no_argument, NULL, 'I'},
+                             {"engines", no_argument, NULL, 'E'},
                              {NULL, 0, NULL, 0}};
 
   char *input = "data/test.txt";
   int time_limit = 1800;
+  bool scaling = false;
+  bool kernels = false;
+  bool engines = false;
+  char *profile_file = NULL;
+  char *events = NULL;
+  bool quiet = false;
+  char *warm_file = NULL;
+  bool resume = false;
+  warm_start_t warm_start = {NULL, 0, 0, 0, NULL};
+  warm_start_t *warm = NULL;
+  char **specs = malloc(sizeof(char *) * argc);
+  int n_configs = 0;
+  params_t params;
+  default_params(&params);
 
   for (int opt; (opt = getopt_long(argc, argv, opts, options, NULL)) != -1;) {
     switch (opt) {
@@ -56,18 +327,154 @@ int main(int argc, char **argv) {
     case 't':
       time_limit = (int)strtol(optarg, NULL, 10);
       break;
+    case 'n':
+      params.n_threads = (int)strtol(optarg, NULL, 10);
+      break;
+    case 'T':
+      params.table_bytes = (size_t)strtol(optarg, NULL, 10) << 20;
+      break;
+    case 'P':
+      if (strcmp(optarg, "always") == 0) {
+        params.table_policy = REPLACE_ALWAYS;
+      } else if (strcmp(optarg, "depth") == 0) {
+        params.table_policy = REPLACE_DEPTH;
+      } else {
+        fprintf(stderr, "Unknown table policy: %s\n", optarg);
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'p':
+      profile_file = optarg;
+      params.profile = true;
+      break;
+    case 'e':
+      events = optarg;
+      break;
+    case 'w':
+      warm_file = optarg;
+      warm = &warm_start;
+      break;
+    case 'L':
+      warm_start.lb = (int)strtol(optarg, NULL, 10);
+      warm = &warm_start;
+      break;
+    case 'U':
+      warm_start.ub = (int)strtol(optarg, NULL, 10);
+      warm = &warm_start;
+      break;
+    case 'c':
+      checkpoint_file = optarg;
+      break;
+    case 'r':
+      resume = true;
+      break;
+    case 'M':
+      params.memory_bytes = (size_t)strtol(optarg, NULL, 10) << 10;
+      break;
+    case 'R':
+      if (!parse_rules(optarg, &params.rules)) {
+        return EXIT_FAILURE;
+      }
+      break;
+    case 'C':
+      specs[n_configs++] = optarg;
+      break;
+    case 'q':
+      quiet = true;
+      params.verbose = false;
+      break;
+    case 's':
+      scaling = true;
+      break;
+    case 'g':
+      params.specialized = false;
+      break;
+    case 'k':
+      kernels = true;
+      break;
+    case 'I':
+      params.iterative = true;
+      break;
+    case 'E':
+      engines = true;
+      break;
     default:
       fprintf(stderr, "Unknown option: %c\n", opt);
       return EXIT_FAILURE;
     }
   }
 
-  fprintf(stdout,
-          "Parameters:\n"
-          "\tinput = %s\n"
-          "\ttime_limit = %d\n",
-          input, time_limit);
-  fflush(stdout);
+  if (n_configs > 0 && (resume || scaling || kernels || engines)) {
+    fprintf(stderr, "Portfolio cannot be combined with resuming, scaling,"
+                    " kernels or engines\n");
+    return EXIT_FAILURE;
+  }
+  if (n_configs > 0 && checkpoint_file != NULL) {
+    fprintf(stderr, "Checkpoint is not written by a portfolio\n");
+    checkpoint_file = NULL;
+  }
+
+  if (events != NULL) {
+    if (strcmp(events, "-") == 0) {
+      params.events = stdout;
+    } else if (strspn(events, "0123456789") == strlen(events)) {
+      params.events = fdopen((int)strtol(events, NULL, 10), "w");
+    } else {
+      params.events = fopen(events, "w");
+    }
+    if (params.events == NULL) {
+      fprintf(stderr, "Failed to open event stream: %s\n", events);
+      return EXIT_FAILURE;
+    }
+  }
+
+  /*
+   * Configurations of the portfolio, which inherit the other options
+   */
+  params_t *configs = malloc(sizeof(params_t) * (n_configs + 1));
+  unsigned enabled = params.rules;
+  for (int i = 0; i < n_configs; i++) {
+    configs[i] = params;
+    if (!parse_config(specs[i], &configs[i])) {
+      return EXIT_FAILURE;
+    }
+    enabled = i == 0 ? configs[i].rules : enabled | configs[i].rules;
+  }
+
+  if (warm_file != NULL) {
+    warm_start.sol = read_moves(warm_file, &warm_start.len);
+    if (warm_start.sol == NULL) {
+      fprintf(stderr, "Failed to read moves from: %s\n", warm_file);
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (resume) {
+    if (checkpoint_file == NULL) {
+      fprintf(stderr, "Resuming needs a checkpoint file\n");
+      return EXIT_FAILURE;
+    }
+    warm_start.resume = read_checkpoint(checkpoint_file);
+    if (warm_start.resume == NULL) {
+      fprintf(stderr, "Failed to read checkpoint from: %s\n",
+              checkpoint_file);
+      return EXIT_FAILURE;
+    }
+    warm = &warm_start;
+  }
+  signal(SIGINT, interrupt);
+  signal(SIGTERM, interrupt);
+
+  if (!quiet) {
+    fprintf(stdout,
+            "Parameters:\n"
+            "\tinput = %s\n"
+            "\ttime_limit = %d\n"
+            "\tthreads = %d\n"
+            "\ttable_size = %zu MB\n",
+            input, time_limit, params.n_threads, params.table_bytes >> 20);
+    fflush(stdout);
+  }
 
   instance_t *inst = read_instance(input);
   if (inst == NULL) {
@@ -75,16 +482,106 @@ int main(int argc, char **argv) {
     return EXIT_FAILURE;
   }
 
-  print_instance(stdout, inst);
-  fflush(stdout);
+  if (!quiet) {
+    print_instance(stdout, inst);
+    fflush(stdout);
+  }
+
+  if (scaling) {
+    scale(inst, time_limit, &params, warm);
+    free_instance(inst);
+    return EXIT_SUCCESS;
+  }
+
+  if (kernels) {
+    const char *names[] = {"generic", "specialized"};
+    compare(inst, time_limit, &params, warm, &params.specialized, "Kernels",
+            "kernels", names);
+    free_instance(inst);
+    return EXIT_SUCCESS;
+  }
+
+  if (engines) {
+    const char *names[] = {"recursive", "iterative"};
+    compare(inst, time_limit, &params, warm, &params.iterative, "Engines",
+            "engine", names);
+    free_instance(inst);
+    return EXIT_SUCCESS;
+  }
 
-  report_t *report = solve(inst, time_limit);
+  report_t *report =
+      n_configs > 0 ? run_configs(inst, time_limit, configs, n_configs, warm)
+                    : run(inst, time_limit, &params, warm);
+  if (report == NULL) {
+    fprintf(stderr, "Failed to solve instance from: %s\n", input);
+    free_instance(inst);
+    return EXIT_FAILURE;
+  }
 
-  print_moves(stdout, report->best_sol, report->best_ub);
+  if (!quiet) {
+    print_moves(stdout, report->best_sol, report->best_ub);
+  }
+  if (!quiet && report->table_bytes > 0) {
+    fprintf(stdout,
+            "[table] memory = %zu / lookup = %ld / hit = %ld (%.1f%%) / "
+            "cut = %ld / store = %ld / reject = %ld\n",
+            report->table_bytes, report->n_table_lookup, report->n_table_hit,
+            report->n_table_lookup > 0
+                ? 100.0 * report->n_table_hit / report->n_table_lookup
+                : 0.0,
+            report->n_table_cut, report->n_table_store, report->n_table_reject);
+  }
+  if (!quiet) {
+    fprintf(stdout, "[memory] peak = %zu bytes\n", report->peak_bytes);
+    fprintf(stdout, "[rules]");
+    for (int r = 0; r < N_RULES; r++) {
+      fprintf(stdout, "%s %s = %ld%s", r == 0 ? "" : " /", rule_names[r],
+              report->n_rule_cut[r],
+              enabled & 1u << r ? "" : " (disabled)");
+    }
+    fprintf(stdout, "\n");
+  }
+  if (!quiet && report->n_configs > 0) {
+    fprintf(stdout, "[portfolio]");
+    int roles[] = {report->winner, report->lb_config, report->ub_config};
+    const char *names[] = {"winner", "best_lb", "best_ub"};
+    for (int k = 0; k < 3; k++) {
+      fprintf(stdout, "%s %s = ", k == 0 ? "" : " /", names[k]);
+      if (roles[k] < 0) {
+        fprintf(stdout, "%s", k == 0 ? "none" : k == 1 ? "root" : "initial");
+      } else {
+        fprintf(stdout, "%d (", roles[k]);
+        print_config(stdout, &configs[roles[k]]);
+        fprintf(stdout, ")");
+      }
+    }
+    fprintf(stdout, "\n");
+  }
+  if (!quiet && SEARCH_STATS) {
+    print_stats(stdout, &report->stats);
+  }
+  if (profile_file != NULL) {
+    FILE *fp = fopen(profile_file, "w");
+    if (fp == NULL) {
+      fprintf(stderr, "Failed to open file: %s\n", profile_file);
+    } else {
+      print_profile(fp, report);
+      fclose(fp);
+    }
+  }
   fflush(stdout);
+  if (params.events != NULL && params.events != stdout) {
+    fclose(params.events);
+  }
 
   free_instance(inst);
   free_report(report);
+  free(specs);
+  free(configs);
+  free(warm_start.sol);
+  if (warm_start.resume != NULL) {
+    free_checkpoint(warm_start.resume);
+  }
 
   return EXIT_SUCCESS;
 }
@@ -19,6 +19,62 @@
 #include <stdlib.h>
 #include <string.h>
 
+uint64_t mix_hash(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+static uint64_t slot_key(int s, int t, int p) {
+  return mix_hash((uint64_t)s << 48 ^ (uint64_t)t << 32 ^ (uint32_t)p);
+}
+
+trail_t *malloc_trail(int capacity) {
+  trail_t *trail = malloc(sizeof(trail_t));
+  trail->size = 0;
+  trail->capacity = capacity > 0 ? capacity : 1;
+  trail->slots = malloc(sizeof(slot_t) * trail->capacity);
+  return trail;
+}
+
+void free_trail(trail_t *trail) {
+  free(trail->slots);
+  free(trail);
+}
+
+static void log_slot(state_t *state, int s, int t) {
+  trail_t *trail = state->trail;
+  if (trail->size == trail->capacity) {
+    trail->capacity *= 2;
+    trail->slots = realloc(trail->slots, sizeof(slot_t) * trail->capacity);
+  }
+  slot_t *slot = &trail->slots[trail->size++];
+  slot->s = s;
+  slot->t = t;
+  slot->p = state->p[s][t];
+  slot->q = state->q[s][t];
+  slot->b = state->b[s][t];
+  slot->l = state->l != NULL ? state->l[s][t] : 0;
+  slot->z = state->z != NULL ? state->z[s][t] : 0;
+}
+
+void undo_trail(state_t *state, int mark) {
+  trail_t *trail = state->trail;
+  while (trail->size > mark) {
+    slot_t *slot = &trail->slots[--trail->size];
+    state->p[slot->s][slot->t] = slot->p;
+    state->q[slot->s][slot->t] = slot->q;
+    state->b[slot->s][slot->t] = slot->b;
+    if (state->l != NULL) {
+      state->l[slot->s][slot->t] = slot->l;
+    }
+    if (state->z != NULL) {
+      state->z[slot->s][slot->t] = slot->z;
+    }
+  }
+}
+
 state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
                       bool tracked) {
   state_t *state = malloc(sizeof(state_t));
@@ -27,6 +83,9 @@ state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
   state->has_head = has_head;
   state->has_body = has_body;
   state->tracked = tracked;
+  state->hashed = false;
+  state->hash = 0;
+  state->trail = NULL;
   if (has_head) {
     if (tracked) {
       state->h = malloc(sizeof(int) * 4 * n_stacks);
@@ -42,11 +101,11 @@ state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
   }
   if (has_body) {
     if (tracked) {
-      state->p = malloc(sizeof(int *) * 4 * n_stacks);
+      state->p = malloc(sizeof(cell_t *) * 4 * n_stacks);
       state->q = state->p + 1 * n_stacks;
       state->b = state->p + 2 * n_stacks;
       state->l = state->p + 3 * n_stacks;
-      state->p[0] = malloc(sizeof(int) * 4 * n_stacks * (n_tiers + 1));
+      state->p[0] = malloc(sizeof(cell_t) * 4 * n_stacks * (n_tiers + 1));
       state->q[0] = state->p[0] + 1 * n_stacks * (n_tiers + 1);
       state->b[0] = state->p[0] + 2 * n_stacks * (n_tiers + 1);
       state->l[0] = state->p[0] + 3 * n_stacks * (n_tiers + 1);
@@ -56,12 +115,18 @@ state_t *malloc_state(int n_stacks, int n_tiers, bool has_head, bool has_body,
         state->b[s] = state->b[0] + s * (n_tiers + 1);
         state->l[s] = state->l[0] + s * (n_tiers + 1);
       }
+      state->z = malloc(sizeof(uint32_t *) * n_stacks);
+      state->z[0] = malloc(sizeof(uint32_t) * n_stacks * (n_tiers + 1));
+      for (int s = 1; s < n_stacks; s++) {
+        state->z[s] = state->z[0] + s * (n_tiers + 1);
+      }
     } else {
-      state->p = malloc(sizeof(int *) * 3 * n_stacks);
+      state->p = malloc(sizeof(cell_t *) * 3 * n_stacks);
       state->q = state->p + 1 * n_stacks;
       state->b = state->p + 2 * n_stacks;
       state->l = NULL;
-      state->p[0] = malloc(sizeof(int) * 3 * n_stacks * (n_tiers + 1));
+      state->z = NULL;
+      state->p[0] = malloc(sizeof(cell_t) * 3 * n_stacks * (n_tiers + 1));
       state->q[0] = state->p[0] + 1 * n_stacks * (n_tiers + 1);
       state->b[0] = state->p[0] + 2 * n_stacks * (n_tiers + 1);
       for (int s = 1; s < n_stacks; s++) {
@@ -81,6 +146,10 @@ void free_state(state_t *state) {
   if (state->has_body) {
     free(state->p[0]);
     free(state->p);
+    if (state->z != NULL) {
+      free(state->z[0]);
+      free(state->z);
+    }
   }
   free(state);
 }
@@ -88,6 +157,7 @@ void free_state(state_t *state) {
 void copy_state_head(state_t *dst_state, state_t *src_state) {
   dst_state->n_blocks = src_state->n_blocks;
   dst_state->n_bad = src_state->n_bad;
+  dst_state->hash = src_state->hash;
   if (dst_state->tracked) {
     memcpy(dst_state->h, src_state->h, sizeof(int) * 4 * dst_state->n_stacks);
   } else {
@@ -98,13 +168,38 @@ void copy_state_head(state_t *dst_state, state_t *src_state) {
 void copy_state_body(state_t *dst_state, state_t *src_state) {
   if (dst_state->tracked) {
     memcpy(dst_state->p[0], src_state->p[0],
-           sizeof(int) * 4 * dst_state->n_stacks * (dst_state->n_tiers + 1));
+           sizeof(cell_t) * 4 * dst_state->n_stacks *
+               (dst_state->n_tiers + 1));
+    memcpy(dst_state->z[0], src_state->z[0],
+           sizeof(uint32_t) * dst_state->n_stacks * (dst_state->n_tiers + 1));
   } else {
     memcpy(dst_state->p[0], src_state->p[0],
-           sizeof(int) * 3 * dst_state->n_stacks * (dst_state->n_tiers + 1));
+           sizeof(cell_t) * 3 * dst_state->n_stacks *
+               (dst_state->n_tiers + 1));
   }
 }
 
+#define COPY_KERNELS(S, T)                                                     \
+  static void copy_state_head_##S##x##T(state_t *dst_state,                   \
+                                        state_t *src_state) {                 \
+    dst_state->n_blocks = src_state->n_blocks;                                 \
+    dst_state->n_bad = src_state->n_bad;                                       \
+    dst_state->hash = src_state->hash;                                         \
+    memcpy(dst_state->h, src_state->h, sizeof(int) * 4 * S);                   \
+  }
+KERNEL_SHAPES(COPY_KERNELS)
+#undef COPY_KERNELS
+
+copy_t find_copy_head(int n_stacks, int n_tiers) {
+#define FIND_COPY_HEAD(S, T)                                                   \
+  if (n_stacks == S && n_tiers == T) {                                         \
+    return copy_state_head_##S##x##T;                                          \
+  }
+  KERNEL_SHAPES(FIND_COPY_HEAD)
+#undef FIND_COPY_HEAD
+  return copy_state_head;
+}
+
 void copy_state(state_t *dst_state, state_t *src_state) {
   copy_state_head(dst_state, src_state);
   copy_state_body(dst_state, src_state);
@@ -113,6 +208,7 @@ void copy_state(state_t *dst_state, state_t *src_state) {
 void reuse_state_head(state_t *dst_state, state_t *src_state) {
   dst_state->n_blocks = src_state->n_blocks;
   dst_state->n_bad = src_state->n_bad;
+  dst_state->hash = src_state->hash;
   dst_state->h = src_state->h;
   dst_state->list = src_state->list;
   dst_state->rank = src_state->rank;
@@ -124,6 +220,7 @@ void reuse_state_body(state_t *dst_state, state_t *src_state) {
   dst_state->q = src_state->q;
   dst_state->b = src_state->b;
   dst_state->l = src_state->l;
+  dst_state->z = src_state->z;
 }
 
 bool is_retrievable(state_t *state) {
@@ -131,6 +228,19 @@ bool is_retrievable(state_t *state) {
          state->b[state->list[0]][state->h[state->list[0]]] == 0;
 }
 
+bool is_same_stack(state_t *state, int s1, int s2) {
+  int h = state->h[s1];
+  if (state->h[s2] != h || state->z[s1][h] != state->z[s2][h]) {
+    return false;
+  }
+  for (int t = h; t > 0; t--) {
+    if (state->p[s1][t] != state->p[s2][t]) {
+      return false;
+    }
+  }
+  return true;
+}
+
 static int compare(state_t *state, int s1, int s2) {
   return state->q[s1][state->h[s1]] - state->q[s2][state->h[s2]];
 }
@@ -154,6 +264,9 @@ static void adjust_right(state_t *state, int s) {
 }
 
 void update_slot(state_t *state, int s, int t, int p, int l) {
+  if (state->trail != NULL) {
+    log_slot(state, s, t);
+  }
   state->p[s][t] = p;
   if (t == 0 || p <= state->q[s][t - 1]) {
     state->q[s][t] = p;
@@ -164,18 +277,24 @@ void update_slot(state_t *state, int s, int t, int p, int l) {
   }
   if (state->tracked) {
     state->l[s][t] = l;
+    state->z[s][t] = ((t == 0 ? 0 : state->z[s][t - 1]) ^ (uint32_t)p) *
+                     UINT32_C(0x9e3779b1);
   }
 }
 
 void init_state(state_t *state, instance_t *inst) {
   state->n_blocks = inst->n_blocks;
   state->n_bad = 0;
+  state->hash = 0;
   for (int s = 0; s < state->n_stacks; s++) {
     state->h[s] = inst->h[s];
     update_slot(state, s, 0, inst->max_prio + 1, 0);
     for (int t = 1; t <= state->h[s]; t++) {
       update_slot(state, s, t, inst->p[s][t], 0);
       state->n_bad += state->b[s][t] > 0;
+      if (state->hashed) {
+        state->hash ^= slot_key(s, t, inst->p[s][t]);
+      }
     }
     state->list[state->rank[s] = s] = s;
     adjust_left(state, s);
@@ -186,7 +305,14 @@ void init_state(state_t *state, instance_t *inst) {
   }
 }
 
+/*
+ * The hash only depends on the occupied slots, so it is updated where heights
+ * change rather than in update_slot, which may rewrite a slot of a shared body
+ */
 void move_out(state_t *state, int s, int l) {
+  if (state->hashed) {
+    state->hash ^= slot_key(s, state->h[s], state->p[s][state->h[s]]);
+  }
   if (state->b[s][state->h[s]--] > 0) {
     state->n_bad--;
   } else {
@@ -199,6 +325,9 @@ void move_out(state_t *state, int s, int l) {
 
 void move_in(state_t *state, int d, int p, int l) {
   update_slot(state, d, ++state->h[d], p, l);
+  if (state->hashed) {
+    state->hash ^= slot_key(d, state->h[d], p);
+  }
   if (state->b[d][state->h[d]] > 0) {
     state->n_bad++;
   } else {
@@ -217,6 +346,9 @@ void relocate(state_t *state, int s, int d, int l) {
 
 void retrieve(state_t *state, int l) {
   int s = state->list[0];
+  if (state->hashed) {
+    state->hash ^= slot_key(s, state->h[s], state->p[s][state->h[s]]);
+  }
   state->n_blocks--;
   state->h[s]--;
   adjust_right(state, s);
@@ -20,6 +20,52 @@
 
 #include "instance.h"
 #include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Cell of the body matrices. Priorities are relabelled to 1...n_blocks by the
+ * solver, and badness and times are bounded by the number of tiers and the
+ * search depth, so narrow cells suffice for practical bays and cut the memory
+ * copied per node. The width is chosen at build time by CELL_BITS.
+ */
+#ifndef CELL_BITS
+#define CELL_BITS 16
+#endif
+#if CELL_BITS == 8
+typedef int8_t cell_t;
+#define CELL_MAX INT8_MAX
+#elif CELL_BITS == 16
+typedef int16_t cell_t;
+#define CELL_MAX INT16_MAX
+#elif CELL_BITS == 32
+typedef int32_t cell_t;
+#define CELL_MAX INT32_MAX
+#else
+#error "CELL_BITS must be 8, 16 or 32"
+#endif
+
+/*
+ * Bay shapes (n_stacks, n_tiers) with kernels specialized for constant
+ * dimensions. Each shape needs an instantiation of lower_bound_kernel.h in
+ * lower_bound.c.
+ */
+#define KERNEL_SHAPES(X) X(6, 4) X(6, 5) X(8, 5) X(10, 6)
+
+typedef struct {
+  int s;    // stack
+  int t;    // tier
+  cell_t p; // overwritten priority
+  cell_t q; // overwritten quality
+  cell_t b; // overwritten badness
+  cell_t l; // overwritten time
+  uint32_t z; // overwritten signature
+} slot_t;
+
+typedef struct {
+  int size;      // number of logged slots
+  int capacity;  // number of slots allocated
+  slot_t *slots; // slots[i]: i-th overwritten slot
+} trail_t;
 
 typedef struct {
   int n_stacks;  // number of stacks, indexed from 0 to n_stacks - 1
@@ -27,6 +73,7 @@ typedef struct {
   bool has_head; // true if including head arrays
   bool has_body; // true if including body matrices
   bool tracked;  // true if including tracking information
+  bool hashed;   // true if maintaining the Zobrist hash
 
   int n_blocks;          // number of blocks
   int n_bad;             // number of badly-placed blocks
@@ -34,15 +81,54 @@ typedef struct {
   int *list;             // list[i]: i-th stack in the ordered list
   int *rank;             // rank[s]: rank of stack s
   int *last_change_time; // last_change_time[s]: time of last change to stack s
+  uint64_t hash;         // Zobrist hash of the blocks in the stacks
+  trail_t *trail;        // journal of overwritten slots, NULL if not logged
 
-  int **p; // p[s][t]: priority
-  int **q; // q[s][t]: quality, i.e., smallest among p[s][1...h[s]]
-  int **b; // b[s][t]: badness, i.e., number of consecutive badly-placed blocks
-  int **l; // l[s][t]: time when the block is put into slot (s, t)
+  cell_t **p; // p[s][t]: priority
+  cell_t **q; // q[s][t]: quality, i.e., smallest among p[s][1...h[s]]
+  cell_t **b; // b[s][t]: badness, i.e., number of consecutive badly-placed
+              // blocks
+  cell_t **l; // l[s][t]: time when the block is put into slot (s, t)
+  uint32_t **z; // z[s][t]: signature of the blocks p[s][1...t], which is
+                // equal for stacks holding the same blocks
 } state_t;
 
 /**
- * Create space for a state
+ * Mix the bits of a 64-bit value, which is used to derive Zobrist keys
+ *
+ * @param x the value
+ * @return mixed value
+ */
+uint64_t mix_hash(uint64_t x);
+
+/**
+ * Create a trail, i.e., a journal of overwritten slots that grows on demand
+ *
+ * @param capacity initial number of slots
+ * @return created trail
+ */
+trail_t *malloc_trail(int capacity);
+
+/**
+ * Free the space of a trail
+ *
+ * @param trail the trail
+ */
+void free_trail(trail_t *trail);
+
+/**
+ * Restore the slots overwritten since a mark of the trail, in reverse order,
+ * and truncate the trail to the mark
+ *
+ * @param state a state whose body is the one logged by the trail
+ * @param mark size of the trail to return to
+ */
+void undo_trail(state_t *state, int mark);
+
+/**
+ * Create space for a state. The Zobrist hash is not maintained unless hashed
+ * is set to true before the state is initialized, and slots are not logged
+ * unless trail is set.
  *
  * @param n_stacks number of stacks
  * @param n_tiers number of tiers
@@ -77,6 +163,19 @@ void copy_state_head(state_t *dst_state, state_t *src_state);
  */
 void copy_state_body(state_t *dst_state, state_t *src_state);
 
+typedef void (*copy_t)(state_t *dst_state, state_t *src_state);
+
+/**
+ * Find the kernel copying head arrays of tracked states, which is specialized
+ * with constant sizes if the shape is in KERNEL_SHAPES and copy_state_head
+ * otherwise
+ *
+ * @param n_stacks number of stacks
+ * @param n_tiers number of tiers
+ * @return copy kernel
+ */
+copy_t find_copy_head(int n_stacks, int n_tiers);
+
 /**
  * Fully copy a state
  *
@@ -109,6 +208,17 @@ void reuse_state_body(state_t *dst_state, state_t *src_state);
  */
 bool is_retrievable(state_t *state);
 
+/**
+ * Check if two stacks hold the same blocks, comparing their signatures before
+ * their slots
+ *
+ * @param state a tracked state
+ * @param s1 a stack
+ * @param s2 another stack
+ * @return true if the stacks hold the same blocks
+ */
+bool is_same_stack(state_t *state, int s1, int s2);
+
 /**
  * Update matrix information for a slot
  *
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "stats.h"
+
+static const char *counter_names[N_COUNTERS] = {
+    "lb_node", "lb_dest",   "lb_traced", "lb_child", "retrieve",
+    "lb4",     "lb4_trace", "lb4_child", "minmax"};
+
+static const char *timer_names[N_TIMERS] = {"copy", "retrieve", "lb4",
+                                            "minmax", "undo"};
+
+void add_stats(stats_t *total, const stats_t *stats) {
+  for (int c = 0; c < N_COUNTERS; c++) {
+    total->count[c] += stats->count[c];
+  }
+  for (int c = 0; c < N_TIMERS; c++) {
+    total->cycles[c] += stats->cycles[c];
+  }
+}
+
+void print_stats(FILE *fp, const stats_t *stats) {
+  fprintf(fp, "[stats]");
+  for (int c = 0; c < N_COUNTERS; c++) {
+    fprintf(fp, "%s %s = %ld", c == 0 ? "" : " /", counter_names[c],
+            stats->count[c]);
+  }
+  fprintf(fp, "\n");
+
+  if (SEARCH_STATS >= 2) {
+    long total = 0;
+    for (int c = 0; c < N_TIMERS; c++) {
+      total += stats->cycles[c];
+    }
+    fprintf(fp, "[cycles]");
+    for (int c = 0; c < N_TIMERS; c++) {
+      fprintf(fp, "%s %s = %ld (%.1f%%)", c == 0 ? "" : " /", timer_names[c],
+              stats->cycles[c],
+              total > 0 ? 100.0 * stats->cycles[c] / total : 0.0);
+    }
+    fprintf(fp, "\n");
+  }
+}
+
+void print_stats_json(FILE *fp, const stats_t *stats) {
+  fprintf(fp, "{");
+  for (int c = 0; c < N_COUNTERS; c++) {
+    fprintf(fp, "%s\"%s\": %ld", c == 0 ? "" : ", ", counter_names[c],
+            stats->count[c]);
+  }
+  if (SEARCH_STATS >= 2) {
+    for (int c = 0; c < N_TIMERS; c++) {
+      fprintf(fp, ", \"%s_cycles\": %ld", timer_names[c], stats->cycles[c]);
+    }
+  }
+  fprintf(fp, "}");
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+/*
+ * Level of hot-path instrumentation: 0 compiles it out, 1 counts the events
+ * and 2 also times the kernels by cycle counters
+ */
+#ifndef SEARCH_STATS
+#define SEARCH_STATS 0
+#endif
+
+typedef enum {
+  COUNT_LB_NODE,   // nodes pruned by the bound of the relocated block
+  COUNT_LB_DEST,   // branches pruned by the bound of the destination
+  COUNT_LB_TRACED, // branches pruned by LB4 derived from the trace
+  COUNT_LB_CHILD,  // branches pruned by LB4 of the child from scratch
+  COUNT_RETRIEVE,  // blocks retrieved while generating branches
+  COUNT_LB4,       // LB4 computed from scratch
+  COUNT_LB4_TRACE, // LB4 traced for the children
+  COUNT_LB4_CHILD, // LB4 derived from a trace
+  COUNT_MINMAX,    // calls of MinMax for probing
+  N_COUNTERS
+} stats_counter_t;
+
+typedef enum {
+  TIMER_COPY,     // copying heads and moving the relocated block
+  TIMER_RETRIEVE, // retrieval loop of the children
+  TIMER_LB4,      // LB4 from scratch or from a trace
+  TIMER_MINMAX,   // MinMax for probing
+  TIMER_UNDO,     // undoing the trail
+  N_TIMERS
+} stats_timer_t;
+
+typedef struct {
+  long count[N_COUNTERS]; // count[c]: number of events c
+  long cycles[N_TIMERS];  // cycles[c]: cycles spent in c
+} stats_t;
+
+#if SEARCH_STATS >= 1
+#define STATS_COUNT(stats, c) ((stats)->count[c]++)
+#else
+#define STATS_COUNT(stats, c) ((void)0)
+#endif
+
+#if SEARCH_STATS >= 2
+#define STATS_START(t0) uint64_t t0 = read_cycles()
+#define STATS_STOP(stats, c, t0) ((stats)->cycles[c] += read_cycles() - (t0))
+#else
+#define STATS_START(t0) ((void)0)
+#define STATS_STOP(stats, c, t0) ((void)0)
+#endif
+
+/**
+ * Read the cycle counter, or a nanosecond clock where there is none
+ *
+ * @return current count
+ */
+static inline uint64_t read_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t t;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(t));
+  return t;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+/**
+ * Add statistics to a total
+ *
+ * @param total the total
+ * @param stats statistics to be added
+ */
+void add_stats(stats_t *total, const stats_t *stats);
+
+/**
+ * Print the counters, and the timers if compiled in
+ *
+ * @param fp output stream
+ * @param stats the statistics
+ */
+void print_stats(FILE *fp, const stats_t *stats);
+
+/**
+ * Write the counters, and the timers if compiled in, as a JSON object
+ *
+ * @param fp output stream
+ * @param stats the statistics
+ */
+void print_stats_json(FILE *fp, const stats_t *stats);
+
+#endif
@@ -19,3 +19,9 @@
 #include <time.h>
 
 double get_time(void) { return (double)clock() / CLOCKS_PER_SEC; }
+
+double get_wall_time(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
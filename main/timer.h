@@ -25,4 +25,11 @@
  */
 double get_time(void);
 
+/**
+ * Get the current wall-clock time, which is meaningful across threads
+ *
+ * @return current timestamp in seconds
+ */
+double get_wall_time(void);
+
 #endif
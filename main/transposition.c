@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "transposition.h"
+#include <stdlib.h>
+
+table_t *malloc_table(size_t n_bytes, policy_t policy) {
+  size_t n_entries = 1;
+  while (n_entries * 2 * sizeof(entry_t) <= n_bytes) {
+    n_entries *= 2;
+  }
+  if (n_entries * sizeof(entry_t) > n_bytes) {
+    return NULL;
+  }
+
+  table_t *table = malloc(sizeof(table_t));
+  table->n_entries = n_entries;
+  table->policy = policy;
+  table->entries = calloc(n_entries, sizeof(entry_t));
+  return table;
+}
+
+void free_table(table_t *table) {
+  free(table->entries);
+  free(table);
+}
+
+void clear_table(table_t *table) {
+  for (size_t i = 0; i < table->n_entries; i++) {
+    table->entries[i].check = 0;
+    table->entries[i].data = 0;
+  }
+}
+
+static bool load_entry(entry_t *entry, uint64_t *key, uint64_t *data) {
+  *data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+  *key = __atomic_load_n(&entry->check, __ATOMIC_RELAXED) ^ *data;
+  return *data != 0;
+}
+
+bool lookup_table(table_t *table, uint64_t key, int *bound) {
+  entry_t *entry = &table->entries[key & (table->n_entries - 1)];
+  uint64_t old_key;
+  uint64_t old_data;
+  if (load_entry(entry, &old_key, &old_data) && old_key == key) {
+    *bound = (int)old_data;
+    return true;
+  }
+  return false;
+}
+
+bool store_table(table_t *table, uint64_t key, int bound) {
+  entry_t *entry = &table->entries[key & (table->n_entries - 1)];
+  uint64_t data = (uint64_t)bound;
+  uint64_t old_key;
+  uint64_t old_data;
+  if (load_entry(entry, &old_key, &old_data)) {
+    if (old_key == key) {
+      if (old_data >= data) {
+        return true;
+      }
+    } else if (table->policy == REPLACE_DEPTH && old_data > data) {
+      return false;
+    }
+  }
+  __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+  __atomic_store_n(&entry->check, key ^ data, __ATOMIC_RELAXED);
+  return true;
+}
+
+size_t table_bytes(table_t *table) {
+  return sizeof(table_t) + sizeof(entry_t) * table->n_entries;
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2021 Bo Jin <jinbostar@gmail.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum {
+  REPLACE_ALWAYS, // a new entry always overwrites the old one
+  REPLACE_DEPTH   // a new entry overwrites the old one unless it is weaker
+} policy_t;
+
+typedef struct {
+  uint64_t check; // key XOR data, so that torn entries are never matched
+  uint64_t data;  // stored bound
+} entry_t;
+
+typedef struct {
+  size_t n_entries; // number of entries, which is a power of two
+  policy_t policy;  // replacement policy
+  entry_t *entries; // entries indexed by the low bits of the key
+} table_t;
+
+/**
+ * Create a transposition table. Entries can be read and written concurrently
+ * by multiple threads without locks.
+ *
+ * @param n_bytes maximum memory of the entries in bytes
+ * @param policy replacement policy
+ * @return created table or NULL if n_bytes is too small
+ */
+table_t *malloc_table(size_t n_bytes, policy_t policy);
+
+/**
+ * Free the space of a transposition table
+ *
+ * @param table the table
+ */
+void free_table(table_t *table);
+
+/**
+ * Remove all entries of a transposition table
+ *
+ * @param table the table
+ */
+void clear_table(table_t *table);
+
+/**
+ * Look up the bound stored for a key
+ *
+ * @param table the table
+ * @param key the key
+ * @param bound stored bound if found
+ * @return true if found
+ */
+bool lookup_table(table_t *table, uint64_t key, int *bound);
+
+/**
+ * Store a bound for a key. If the key is already stored, the larger bound is
+ * kept.
+ *
+ * @param table the table
+ * @param key the key
+ * @param bound the bound
+ * @return false if rejected by the replacement policy
+ */
+bool store_table(table_t *table, uint64_t key, int bound);
+
+/**
+ * Get the memory used by the entries of a transposition table
+ *
+ * @param table the table
+ * @return memory in bytes
+ */
+size_t table_bytes(table_t *table);
+
+#endif
@@ -27,9 +27,9 @@ int minmax(state_t *state, move_t *path, int len, int max_len) {
   int n_tiers = state->n_tiers;
   int *h = state->h;
   int *list = state->list;
-  int **p = state->p;
-  int **q = state->q;
-  int **b = state->b;
+  cell_t **p = state->p;
+  cell_t **q = state->q;
+  cell_t **b = state->b;
 
   while (state->n_bad > 0) {
     while (is_retrievable(state)) {